@@ -17,6 +17,13 @@ COMPILER_FLAGS:
   -d, --debug
   -a, --alloc
   --arch <sim|x64>
+  -g
+  -O<0|1|2|3|s|z>
+  --march <native|cpu>
+  --mattr <features>
+  --profile-generate[=FILE]
+  --profile-use=FILE
+  --instrument-functions[=FILE]
 EOF
 }
 
@@ -24,6 +31,7 @@ out="out"
 arch="x64"
 inputs=()
 compiler_args=()
+link_args=()
 
 while [[ $# -gt 0 ]]; do
   case "$1" in
@@ -34,7 +42,7 @@ while [[ $# -gt 0 ]]; do
       shift
       ;;
 
-    -p|--print-ast|--trace-parsing|--trace-scanning|-d|--debug|-a|--alloc)
+    -p|--print-ast|--trace-parsing|--trace-scanning|-d|--debug|-a|--alloc|-g|-O0|-O1|-O2|-O3|-Os|-Oz)
       compiler_args+=("$1")
       shift
       ;;
@@ -47,6 +55,24 @@ while [[ $# -gt 0 ]]; do
       shift
       ;;
       
+    --march|--mattr)
+      [[ $# -gt 1 ]] || { echo "error: $1 requires an argument" >&2; usage; exit 2; }
+      compiler_args+=("$1" "$2")
+      shift 2
+      ;;
+
+    --profile-generate|--profile-generate=*)
+      # The instrumented program needs the profile runtime of clang
+      compiler_args+=("$1")
+      link_args+=("-fprofile-instr-generate")
+      shift
+      ;;
+
+    --profile-use=*|--instrument-functions|--instrument-functions=*)
+      compiler_args+=("$1")
+      shift
+      ;;
+
     -h|--help)
       usage
       exit 0
@@ -69,21 +95,24 @@ done
 
 mkdir -p ./build
 
-if [[ "$arch" == "x64" ]]; then
-nasm -f elf64 ./stdlib/stdfunc.asm -o ./build/stdfunc.o
-fi
-
-ll_files=()
 for src in "${inputs[@]}"; do
   [[ -f "$src" ]] || { echo "error: input not found: $src" >&2; exit 2; }
-
-  base="$(basename "$src")"
-  base="${base%.*}"
-  ll="./build/${base}.ll"
-
-  ./build/compiler "${compiler_args[@]}" -o "$ll" "$src"
-  ll_files+=("$ll")
 done
+
+obj_files=()
+if [[ "$arch" == "x64" ]]; then
+# All sources go into one module, so calls between them can be inlined.
+# The object file comes straight from the compiler with the stdlib bitcode
+# already linked in, clang only links it. Nothing else is linked, so the
+# module is the whole program.
+base="$(basename "$out")"
+obj="./build/${base%.*}.o"
+./build/compiler "${compiler_args[@]}" --whole-program --emit obj -o "$obj" "${inputs[@]}"
+obj_files+=("$obj")
+else
+# Emulator sources are independent modules, compiled in parallel into ./build
+./build/compiler "${compiler_args[@]}" --batch -o ./build "${inputs[@]}"
+fi
  
 if [[ "$out" == */* ]]; then
   clang_out="$out"
@@ -92,5 +121,5 @@ else
 fi
 
 if [[ "$arch" == "x64" ]]; then
-clang "${ll_files[@]}" ./build/stdfunc.o -o "$clang_out"
+clang ${link_args[@]+"${link_args[@]}"} "${obj_files[@]}" -o "$clang_out"
 fi
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace func {
+
+namespace {
+
+thread_local arena* current_arena = nullptr;
+
+// Every arena_allocated object is preceded by the arena it came from,
+// nullptr for the heap. The header keeps the object maximally aligned.
+constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+} // namespace
+
+void* arena::allocate(std::size_t size) {
+    size = (size + HEADER_SIZE - 1) / HEADER_SIZE * HEADER_SIZE;
+    if(size > left) {
+        std::size_t chunk_size = std::max(size, CHUNK_SIZE);
+        chunks.emplace_back(new std::byte[chunk_size]);
+        next = chunks.back().get();
+        left = chunk_size;
+    }
+    void* ptr = next;
+    next += size;
+    left -= size;
+    return ptr;
+}
+
+arena::scope::scope(arena& current) : previous{ current_arena } {
+    current_arena = &current;
+}
+
+arena::scope::~scope() {
+    current_arena = previous;
+}
+
+void* arena_allocated::operator new(std::size_t size) {
+    arena* owner = current_arena;
+    void* base = owner != nullptr ? owner->allocate(HEADER_SIZE + size) :
+                                    ::operator new(HEADER_SIZE + size);
+    *static_cast<arena**>(base) = owner;
+    return static_cast<std::byte*>(base) + HEADER_SIZE;
+}
+
+void arena_allocated::operator delete(void* ptr) noexcept {
+    if(ptr == nullptr)
+        return;
+    void* base = static_cast<std::byte*>(ptr) - HEADER_SIZE;
+    if(*static_cast<arena**>(base) == nullptr)
+        ::operator delete(base);
+}
+
+} // namespace func
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace func {
+
+// Bump allocator for the AST of one translation unit. Objects are never
+// released one by one, all memory goes away with the arena at once, so it
+// has to outlive everything allocated from it.
+class arena {
+    static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+    std::vector<std::unique_ptr<std::byte[]>> chunks;
+    std::byte* next{ nullptr };
+    std::size_t left{ 0 };
+
+    public:
+    arena() = default;
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t size);
+
+    // While alive, arena_allocated objects created on this thread go to
+    // the given arena.
+    class scope {
+        arena* previous;
+
+        public:
+        explicit scope(arena& current);
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+        ~scope();
+    };
+};
+
+// Objects of derived classes are placed into the current arena of the
+// thread, or on the heap if there is none. Deleting an arena object only
+// runs its destructor, the memory stays with the arena.
+struct arena_allocated {
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr) noexcept;
+};
+
+} // namespace func
@@ -12,6 +12,7 @@
   #include "node/program.hpp"
   #include "node/function.hpp"
   #include "type/type.hpp"
+  #include "symbol.hpp"
   #include <string>
   #include <variant>
 
@@ -72,7 +73,7 @@
 ;
 
 %token <std::string> STR "str"
-%token <std::string> ID "id"
+%token <func::symbol> ID "id"
 %token <int>  NUM "num"
 %token <bool> BOOLS "bools"
 
@@ -93,10 +94,10 @@
 %type  <std::vector<unique_ptr<func::ast_node>>> arg_list
 %type  <std::vector<unique_ptr<func::ast_node>>> args
 
-%type  <unique_ptr<func::type>>  type 
-%type  <unique_ptr<func::type>>  func_res_type
-%type  <std::vector<unique_ptr<func::type>>>  func_type
-%type  <std::vector<unique_ptr<func::type>>>  func_type_rec
+%type  <const func::type*>  type 
+%type  <const func::type*>  func_res_type
+%type  <std::vector<const func::type*>>  func_type
+%type  <std::vector<const func::type*>>  func_type_rec
 
 
 %%
@@ -122,7 +123,7 @@ function:
 
 declaration:
   func_res_type "id" "(" param_list ")" { 
-    $$ = std::make_unique<func::declaration>(std::move($1), $2, std::move($4), @$);
+    $$ = std::make_unique<func::declaration>($1, $2, std::move($4), @$);
   }
 
 param_list:
@@ -145,7 +146,7 @@ params:
 
 param:
   type "id" {
-    $$ = func::parameter(std::move($1), $2);
+    $$ = func::parameter($1, $2);
   };
 
 
@@ -180,8 +181,8 @@ statements:
 %precedence "else";
 
 statement: 
-  type "id" ";" {$$ = std::make_unique<func::assign_statement>(std::move($1), $2, @$);}
-| type "id" "=" exp ";" {$$ = std::make_unique<func::assign_statement>(std::move($1), $2, std::move($4), @$);}
+  type "id" ";" {$$ = std::make_unique<func::assign_statement>($1, $2, @$);}
+| type "id" "=" exp ";" {$$ = std::make_unique<func::assign_statement>($1, $2, std::move($4), @$);}
 | "id" "=" exp ";" {$$ = std::make_unique<func::assign_statement>($1, std::move($3), @$);}
 | exp "[" exp "]" "=" exp ";" {$$ = std::make_unique<func::subscript_assign_statement>(std::move($1), std::move($3), std::move($6),  @$);}
 | exp "(" arg_list ")" ";" {$$ = std::make_unique<func::function_call>(std::move($1), std::move($3), @$);}
@@ -251,37 +252,37 @@ args:
 
 
 type:
-  "int"     {$$ = std::make_unique<func::int_type>();}
-| "bool"    {$$ = std::make_unique<func::bool_type>();}
-| "string"  {$$ = std::make_unique<func::string_type>();}
-| "(" func_type ")"  {$$ = std::make_unique<func::function_type>(std::move($2));};
+  "int"     {$$ = func::type_context::get_int();}
+| "bool"    {$$ = func::type_context::get_bool();}
+| "string"  {$$ = func::type_context::get_string();}
+| "(" func_type ")"  {$$ = func::type_context::get_function(std::move($2));};
 
 
 func_type:
   type "-" func_type_rec {
-    $3.insert($3.begin(), std::move($1));
+    $3.insert($3.begin(), $1);
     $$ = std::move($3);
     }
 | "void" "-" func_res_type {
-  auto typevec = vector<unique_ptr<func::type>>();
-  typevec.push_back(std::make_unique<func::void_type>());
-  typevec.push_back(std::move($3));
+  auto typevec = vector<const func::type*>();
+  typevec.push_back(func::type_context::get_void());
+  typevec.push_back($3);
   $$ = std::move(typevec);
   };
 
 func_res_type:
-  type {$$ = std::move(std::move($1));}
-| "void" {$$ = std::make_unique<func::void_type>();};
+  type {$$ = $1;}
+| "void" {$$ = func::type_context::get_void();};
 
 
  func_type_rec:
   type "-" func_type_rec {
-  $3.insert($3.begin(), std::move($1));
+  $3.insert($3.begin(), $1);
   $$ = std::move($3);
   }
 | func_res_type {
-  $$ = vector<unique_ptr<func::type>>();
-  $$.push_back(std::move($1));
+  $$ = vector<const func::type*>();
+  $$.push_back($1);
 };
 
 %%
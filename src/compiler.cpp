@@ -2,30 +2,307 @@
 #include "driver.hpp"
 #include "exception.hpp"
 #include "printer.hpp"
+#include "time_report.hpp"
 #include "visitor/code_visitor/code_visitor.hpp"
+#include "visitor/llvm_visitor/llvm_jit.hpp"
 #include "visitor/llvm_visitor/llvm_visitor.hpp"
+#include "node/program.hpp"
 #include "visitor/print_visitor/print_visitor.hpp"
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <set>
+#include <thread>
+#include <vector>
 
 enum class Arch{
     SIM,
     X64
 };
 
-int main(int argc, char* argv[]) {
+namespace {
+
+struct compile_settings {
+    bool print_ast{ false };
+    bool debug_mode{ false };
+    bool alloc_trace{ false };
+    bool trace_parsing{ false };
+    bool trace_scanning{ false };
+    bool run{ false };
+    Arch target_arch{ Arch::X64 };
+    func::llvm_options llvm_opts;
+    std::optional<std::string> stdlib_path;
+    // Collects phase timings when --time-report or --time-report-json is given
+    func::time_report* report{ nullptr };
+    bool time_report_text{ false };
+    std::string time_report_json;
+    // Chrome trace-event file, every thread that compiles runs the profiler
+    std::string trace_out;
+};
+
+// Prints the collected timings and writes the trace where the settings ask to.
+// Returns 0 or E_OTHER if a file can't be written.
+int write_reports(const compile_settings& settings) {
+    if(settings.report != nullptr && settings.time_report_text) {
+        settings.report->print(std::cerr);
+    }
+    if(settings.report != nullptr && !settings.time_report_json.empty()) {
+        std::ofstream json_out{ settings.time_report_json };
+        if(!json_out) {
+            std::cerr << "Can't write time report to " << settings.time_report_json << "\n";
+            return func::error_codes::E_OTHER;
+        }
+        settings.report->print_json(json_out);
+    }
+    if(!settings.trace_out.empty()) {
+        std::error_code error;
+        llvm::raw_fd_ostream trace_out{ settings.trace_out, error, llvm::sys::fs::OF_Text };
+        if(error) {
+            std::cerr << "Can't write trace to " << settings.trace_out << ": "
+                      << error.message() << "\n";
+            return func::error_codes::E_OTHER;
+        }
+        llvm::timeTraceProfilerWrite(trace_out);
+    }
+    return 0;
+}
+
+size_t function_count(const std::vector<std::unique_ptr<func::ast_node>>& trees) {
+    size_t count = 0;
+    for(const auto& tree : trees) {
+        if(const auto* progr = dynamic_cast<const func::program*>(tree.get()))
+            count += progr->get_funcs().size();
+    }
+    return count;
+}
+
+// Compiles SOURCES into one module written to OUTPUT_FILE (stdout if empty).
+// Returns 0 or one of func::error_codes. Safe to call from several threads.
+int compile(const std::vector<std::string>& sources,
+            const std::string& output_file,
+            const compile_settings& settings) {
     driver drv;
-    bool print_ast_flag;
-    bool debug_mode_flag;
-    bool alloc_trace_flag;
-    std::string output_file;
-    Arch target_arch;
+    drv.trace_parsing = settings.trace_parsing;
+    drv.trace_scanning = settings.trace_scanning;
+
+    std::vector<std::unique_ptr<func::ast_node>> trees;
+    for(const auto& src : sources) {
+        func::time_report::scope timer{ settings.report, "parse" };
+        llvm::TimeTraceScope trace{ "Parse", src };
+        if(drv.parse(src) != 0) {
+            std::cerr << "Failed to parse " << src << " - exiting.\n";
+            return func::error_codes::E_SYTNTAX;
+        }
+        trees.push_back(std::move(drv.result));
+    }
+    if(settings.report != nullptr) {
+        settings.report->add_count("sources", sources.size());
+        settings.report->add_count("functions", function_count(trees));
+    }
+
+    func::print_visitor print_visitor{ std::cout };
     std::optional<std::reference_wrapper<std::ostream>> output_stream;
 
+    try {
+        if(settings.print_ast) {
+            func::time_report::scope timer{ settings.report, "print ast" };
+            std::cout << " ### Print visitor output:\n";
+            for(const auto& tree : trees) {
+                tree->accept(print_visitor);
+            }
+            std::cout << "\n";
+        }
+
+        std::ofstream out;
+        if(output_file.empty()) {
+            // std::cout << " ### Code visitor output:\n";
+            output_stream = std::cout;
+        } else {
+            out = std::ofstream(output_file, std::ios::binary);
+            output_stream = out;
+        }
+
+        func::printer printer{ output_stream.value().get() };
+        printer.print_code = true;
+        printer.print_debug = settings.debug_mode;
+        printer.print_alloc = settings.alloc_trace;
+
+        switch (settings.target_arch) {
+            case Arch::SIM: {
+                func::code_visitor code_visitor{ printer };
+                {
+                    func::time_report::scope timer{ settings.report, "codegen" };
+                    trees.front()->accept(code_visitor);
+                }
+                {
+                    func::time_report::scope timer{ settings.report, "optimize" };
+                    code_visitor.optimize_code();
+                }
+                {
+                    func::time_report::scope timer{ settings.report, "emit" };
+                    code_visitor.emit_code();
+                }
+                if(settings.report != nullptr)
+                    settings.report->add_count("emulator instructions",
+                                               code_visitor.instruction_count());
+                break;
+            }
+            case Arch::X64: {
+                auto llvm_opts = settings.llvm_opts;
+                llvm_opts.report = settings.report;
+                func::llvm_visitor llvm_visitor{ printer, llvm_opts };
+                {
+                    func::time_report::scope timer{ settings.report, "codegen" };
+                    // Declarations are merged, so all sources share one module
+                    for(const auto& tree : trees) {
+                        tree->accept(llvm_visitor);
+                    }
+                    llvm_visitor.instrument_functions();
+                }
+                if(settings.report != nullptr)
+                    settings.report->add_count("ir instructions", llvm_visitor.instruction_count());
+                if(settings.stdlib_path) {
+                    func::time_report::scope timer{ settings.report, "link stdlib" };
+                    // The JIT brings its own write/read/exit, running in the compiler
+                    if(settings.run)
+                        llvm_visitor.link_library(*settings.stdlib_path, func::runtime_functions());
+                    else
+                        llvm_visitor.link_library(*settings.stdlib_path);
+                }
+                {
+                    func::time_report::scope timer{ settings.report, "optimize" };
+                    llvm_visitor.optimize_module();
+                }
+                if(settings.report != nullptr) {
+                    settings.report->add_count("optimized ir functions",
+                                               llvm_visitor.function_count());
+                    settings.report->add_count("optimized ir instructions",
+                                               llvm_visitor.instruction_count());
+                }
+                if(settings.run) {
+                    // The program may exit on its own, so the reports go first.
+                    // Returning would write them again.
+                    if(int report_code = write_reports(settings); report_code != 0)
+                        exit(report_code);
+                    exit(func::run_jit(llvm_visitor.take_module()));
+                }
+                func::time_report::scope timer{ settings.report, "emit" };
+                llvm_visitor.emit_module();
+                break;
+            }
+            default: {
+                std::cerr << "Unsupported architecture\n";
+                return func::error_codes::E_PARAMS;
+            }
+        }
+
+    } catch(func::unexpected_type_exception& e) {
+        std::cerr << "Syntax error: unexpected type " << e << "\n";
+        return func::error_codes::E_TYPE;
+    } catch(func::symbol_not_found_exception& e) {
+        std::cerr << "Syntax error: symbol not found " << e << "\n";
+        return func::error_codes::E_SYMBOL;
+    } catch(func::symbol_redeclaration_exception& e) {
+        std::cerr << "Syntax error: symbol redeclaration " << e << "\n";
+        return func::error_codes::E_SYMBOL;
+    } catch(func::syntax_exception& e) {
+        std::cerr << "Syntax error: " << e << "\n";
+        return func::error_codes::E_SYTNTAX;
+    } catch(func::global_syntax_exception& e) {
+        std::cerr << "Syntax error: " << e << "\n";
+        return func::error_codes::E_SYTNTAX;
+    } catch(func::codegen_exception& e) {
+        std::cerr << "Codegen error: " << e << "\n";
+        return func::error_codes::E_OTHER;
+    }
+    return 0;
+}
+
+std::string batch_output_file(const std::string& output_dir,
+                              const std::string& source,
+                              const compile_settings& settings) {
+    std::string ext = ".asm";
+    if(settings.target_arch == Arch::X64) {
+        switch(settings.llvm_opts.emit) {
+        case func::emit_type::LL: ext = ".ll"; break;
+        case func::emit_type::BC: ext = ".bc"; break;
+        case func::emit_type::ASM: ext = ".s"; break;
+        case func::emit_type::OBJ: ext = ".o"; break;
+        }
+    }
+    llvm::SmallString<256> path{ output_dir };
+    llvm::sys::path::append(path, llvm::sys::path::stem(source) + ext);
+    return path.str().str();
+}
+
+// Compiles every source as a separate module on up to JOBS threads.
+// Returns the error code of the first failed source in command line order.
+int compile_batch(const std::vector<std::string>& sources,
+                  const std::string& output_dir,
+                  unsigned jobs,
+                  const compile_settings& settings) {
+    std::vector<std::string> outputs;
+    std::set<std::string> unique_outputs;
+    for(const auto& src : sources) {
+        outputs.push_back(batch_output_file(output_dir, src, settings));
+        if(!unique_outputs.insert(outputs.back()).second) {
+            std::cerr << "Several sources map to output " << outputs.back() << "\n";
+            return func::error_codes::E_PARAMS;
+        }
+    }
+
+    std::vector<int> codes(sources.size(), 0);
+    std::atomic<size_t> next_source{ 0 };
+
+    auto worker = [&]() {
+        if(!settings.trace_out.empty())
+            llvm::timeTraceProfilerInitialize(0, "compiler");
+        for(size_t i = next_source++; i < sources.size(); i = next_source++) {
+            codes[i] = compile({ sources[i] }, outputs[i], settings);
+        }
+        // Hands the events of this thread over to the main one
+        if(!settings.trace_out.empty())
+            llvm::timeTraceProfilerFinishThread();
+    };
+
+    std::vector<std::thread> workers;
+    auto workers_count = std::min<size_t>(std::max(jobs, 1U), sources.size());
+    for(size_t i = 0; i < workers_count; i++) {
+        workers.emplace_back(worker);
+    }
+    for(auto& w : workers) {
+        w.join();
+    }
+
+    for(int code : codes) {
+        if(code != 0)
+            return code;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    compile_settings settings;
+    func::time_report report;
+    bool batch_flag;
+    unsigned jobs;
+    std::string output_file;
+    std::vector<std::string> sources;
+
     cxxopts::Options options("compiler", "A compiler for a simple C-like language called FunC.");
 
     // clang-format off
@@ -38,7 +315,46 @@ int main(int argc, char* argv[]) {
     ("a,alloc", "Include alloc traces")
     ("o,output", "Output file",cxxopts::value<std::string>())
     ("arch", "Specify target architecture: sim | x64",
-         cxxopts::value<std::string>()->default_value("x64"));
+         cxxopts::value<std::string>()->default_value("x64"))
+    ("g", "Emit DWARF debug info for x64")
+    ("O", "Optimization level for x64: 0 | 1 | 2 | 3 | s | z",
+         cxxopts::value<std::string>()->default_value("0"))
+    ("emit", "Output kind for x64: ll | bc | asm | obj",
+         cxxopts::value<std::string>()->default_value("ll"))
+    ("march", "Target CPU for x64: native | <cpu>",
+         cxxopts::value<std::string>()->default_value("generic"))
+    ("mattr", "Target features for x64, e.g. +avx2,-avx512f",
+         cxxopts::value<std::string>()->default_value(""))
+    ("profile-generate", "Instrument x64 code to write a raw profile to the file on exit",
+         cxxopts::value<std::string>()->implicit_value("default.profraw"))
+    ("profile-use", "Optimize x64 code with an indexed profile from llvm-profdata",
+         cxxopts::value<std::string>())
+    ("instrument-functions", "Count calls and cycles of x64 functions, the program writes "
+         "the profile to stderr or the file on exit",
+         cxxopts::value<std::string>()->implicit_value(""))
+    ("run", "JIT-compile the x64 module and run its main instead of writing output")
+    ("stdlib", "Standard library bitcode for x64 (default: funcstd.bc next to the compiler)",
+         cxxopts::value<std::string>())
+    ("no-stdlib", "Don't link the standard library bitcode")
+    ("whole-program", "The x64 sources are the whole program, only main is called from outside")
+    ("batch", "Compile every source into its own module, -o names the output directory")
+    ("j,jobs", "Number of threads for --batch (default: number of cores)",
+         cxxopts::value<unsigned>())
+    ("time-report", "Print wall and CPU time of every compile phase and LLVM pass to stderr")
+    ("time-report-json", "Write the time report as JSON to the file",
+         cxxopts::value<std::string>())
+    ("trace-out", "Write a Chrome trace of parsing, functions and LLVM passes to the file",
+         cxxopts::value<std::string>())
+    ("Rpass", "Report x64 optimizations done by passes matching the regex",
+         cxxopts::value<std::string>())
+    ("Rpass-missed", "Report x64 optimizations missed by passes matching the regex",
+         cxxopts::value<std::string>())
+    ("Rpass-analysis", "Report analysis of x64 passes matching the regex",
+         cxxopts::value<std::string>())
+    ("remarks-output", "Write x64 optimization remarks as YAML to the file",
+         cxxopts::value<std::string>())
+    ("remarks-filter", "Only write remarks of passes matching the regex to --remarks-output",
+         cxxopts::value<std::string>());
     // clang-format on
     options.add_options()("source", "The .fc files to proccess",
                           cxxopts::value<std::vector<std::string>>());
@@ -49,11 +365,48 @@ int main(int argc, char* argv[]) {
     try {
         auto result{ options.parse(argc, argv) };
 
-        print_ast_flag = result["print-ast"].as<bool>();
-        drv.trace_parsing = result["trace-parsing"].as<bool>();
-        drv.trace_scanning = result["trace-scanning"].as<bool>();
-        debug_mode_flag = result["debug"].as<bool>();
-        alloc_trace_flag = result["alloc"].as<bool>();
+        settings.print_ast = result["print-ast"].as<bool>();
+        settings.trace_parsing = result["trace-parsing"].as<bool>();
+        settings.trace_scanning = result["trace-scanning"].as<bool>();
+        settings.debug_mode = result["debug"].as<bool>();
+        settings.alloc_trace = result["alloc"].as<bool>();
+        settings.run = result["run"].as<bool>();
+        // Nothing links against a module the JIT runs
+        settings.llvm_opts.whole_program = result["whole-program"].as<bool>() || settings.run;
+        settings.llvm_opts.debug_info = result["g"].as<bool>();
+        batch_flag = result["batch"].as<bool>();
+        settings.time_report_text = result["time-report"].as<bool>();
+        if(result.count("time-report-json")) {
+            settings.time_report_json = result["time-report-json"].as<std::string>();
+        }
+        if(settings.time_report_text || !settings.time_report_json.empty()) {
+            settings.report = &report;
+        }
+        if(result.count("trace-out")) {
+            settings.trace_out = result["trace-out"].as<std::string>();
+        }
+
+        std::pair<const char*, std::string*> remark_regexes[] = {
+            { "Rpass", &settings.llvm_opts.remarks_passed },
+            { "Rpass-missed", &settings.llvm_opts.remarks_missed },
+            { "Rpass-analysis", &settings.llvm_opts.remarks_analysis },
+            { "remarks-filter", &settings.llvm_opts.remarks_filter },
+        };
+        for(auto [flag, regex] : remark_regexes) {
+            if(!result.count(flag))
+                continue;
+            *regex = result[flag].as<std::string>();
+            std::string error;
+            if(!llvm::Regex{ *regex }.isValid(error)) {
+                std::cerr << "Invalid regex for --" << flag << ": " << error << "\n";
+                exit(func::error_codes::E_PARAMS);
+            }
+        }
+        if(result.count("remarks-output")) {
+            settings.llvm_opts.remarks_output = result["remarks-output"].as<std::string>();
+        }
+        jobs = result.count("jobs") ? result["jobs"].as<unsigned>() :
+                                      std::thread::hardware_concurrency();
 
 
         if(result.count("help")) {
@@ -65,91 +418,148 @@ int main(int argc, char* argv[]) {
             output_file = result["output"].as<std::string>();
         }
 
-
-        if(result.count("source")) {
-            auto srcs = result["source"].as<std::vector<std::string>>();
-            if (srcs.size() > 1) {
-                std::cerr << "Module can be compiled from only one source file.\n";
-                exit(func::error_codes::E_PARAMS);
-            }
-            if(drv.parse(srcs[0]) != 0) {
-                std::cerr << "Failed to parse - exiting.\n";
-                exit(func::error_codes::E_SYTNTAX);
-            }
+        if(result.count("stdlib")) {
+            settings.stdlib_path = result["stdlib"].as<std::string>();
         } else {
-            exit(0); // No input files were given.
+            static int anchor;
+            llvm::SmallString<256> default_path{ llvm::sys::path::parent_path(
+            llvm::sys::fs::getMainExecutable(argv[0], &anchor)) };
+            llvm::sys::path::append(default_path, "funcstd.bc");
+            if(llvm::sys::fs::exists(default_path))
+                settings.stdlib_path = default_path.str().str();
+        }
+        if(result["no-stdlib"].as<bool>()) {
+            settings.stdlib_path.reset();
         }
 
+
         std::string arch_str = result["arch"].as<std::string>();
         if (arch_str == "sim") {
-            target_arch = Arch::SIM;
+            settings.target_arch = Arch::SIM;
         } else if (arch_str == "x64") {
-            target_arch = Arch::X64;
+            settings.target_arch = Arch::X64;
         } else {
             std::cerr << "Unknown architecture: " << arch_str << "\n";
             exit(func::error_codes::E_PARAMS);
         }
 
-    } catch(const cxxopts::exceptions::exception& e) {
-        std::cerr << "Error parsing options: " << e.what() << '\n';
-        exit(func::error_codes::E_PARAMS);
-    }
-
-    func::print_visitor print_visitor{ std::cout };
-
-    auto tree = std::move(drv.result);
-    try {
-        if(print_ast_flag) {
-            std::cout << " ### Print visitor output:\n";
-            tree->accept(print_visitor);
-            std::cout << "\n";
+        std::string opt_str = result["O"].as<std::string>();
+        if(opt_str == "0") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::O0;
+        } else if(opt_str == "1") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::O1;
+        } else if(opt_str == "2") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::O2;
+        } else if(opt_str == "3") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::O3;
+        } else if(opt_str == "s") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::Os;
+        } else if(opt_str == "z") {
+            settings.llvm_opts.opt_level = llvm::OptimizationLevel::Oz;
+        } else {
+            std::cerr << "Unknown optimization level: -O" << opt_str << "\n";
+            exit(func::error_codes::E_PARAMS);
         }
 
-        std::ofstream out;
-        if(output_file.empty()) {
-            // std::cout << " ### Code visitor output:\n";
-            output_stream = std::cout;
+        std::string emit_str = result["emit"].as<std::string>();
+        if(emit_str == "ll") {
+            settings.llvm_opts.emit = func::emit_type::LL;
+        } else if(emit_str == "bc") {
+            settings.llvm_opts.emit = func::emit_type::BC;
+        } else if(emit_str == "asm") {
+            settings.llvm_opts.emit = func::emit_type::ASM;
+        } else if(emit_str == "obj") {
+            settings.llvm_opts.emit = func::emit_type::OBJ;
         } else {
-            out = std::ofstream(output_file);
-            output_stream = out;
+            std::cerr << "Unknown output kind: " << emit_str << "\n";
+            exit(func::error_codes::E_PARAMS);
         }
 
-        func::printer printer{ output_stream.value().get() };
-        printer.print_code = true;
-        printer.print_debug = debug_mode_flag;
-        printer.print_alloc = alloc_trace_flag;
+        settings.llvm_opts.cpu = result["march"].as<std::string>();
+        settings.llvm_opts.features = result["mattr"].as<std::string>();
 
-        switch (target_arch) {
-            case Arch::SIM: {
-                func::code_visitor code_visitor{ printer };
-                tree->accept(code_visitor);
-                break;
+        if(result.count("profile-generate") && result.count("profile-use")) {
+            std::cerr << "--profile-generate can't be combined with --profile-use.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+        if(result.count("profile-generate")) {
+            settings.llvm_opts.profile_generate = result["profile-generate"].as<std::string>();
+        }
+        if(result.count("profile-use")) {
+            settings.llvm_opts.profile_use = result["profile-use"].as<std::string>();
+            if(!llvm::sys::fs::exists(settings.llvm_opts.profile_use)) {
+                std::cerr << "Profile not found: " << settings.llvm_opts.profile_use << "\n";
+                exit(func::error_codes::E_PARAMS);
             }
-            case Arch::X64: {
-                func::llvm_visitor llvm_visitor{ printer };
-                tree->accept(llvm_visitor);
-                break;
+        }
+
+        if(result.count("instrument-functions")) {
+            settings.llvm_opts.instrument_functions = true;
+            settings.llvm_opts.instrument_output = result["instrument-functions"].as<std::string>();
+            // The profile is written by the stdlib runtime
+            if(!settings.stdlib_path) {
+                std::cerr << "--instrument-functions needs the standard library.\n";
+                exit(func::error_codes::E_PARAMS);
             }
-            default: {
-                std::cerr << "Unsupported architecture\n";
+        }
+
+        if(result.count("source")) {
+            sources = result["source"].as<std::vector<std::string>>();
+            // x64 parses every source into one module, the emulator has no linking
+            if(sources.size() > 1 && settings.target_arch == Arch::SIM && !batch_flag) {
+                std::cerr << "Module can be compiled from only one source file.\n";
                 exit(func::error_codes::E_PARAMS);
             }
+        } else {
+            exit(0); // No input files were given.
         }
 
-    } catch(func::unexpected_type_exception& e) {
-        std::cerr << "Syntax error: unexpected type " << e << "\n";
-        exit(func::error_codes::E_TYPE);
-    } catch(func::symbol_not_found_exception& e) {
-        std::cerr << "Syntax error: symbol not found " << e << "\n";
-        exit(func::error_codes::E_SYMBOL);
-    } catch(func::symbol_redeclaration_exception& e) {
-        std::cerr << "Syntax error: symbol redeclaration " << e << "\n";
-        exit(func::error_codes::E_SYMBOL);
-    } catch(func::syntax_exception& e) {
-        std::cerr << "Syntax error: " << e << "\n";
-        exit(func::error_codes::E_SYTNTAX);
-    } catch(func::global_syntax_exception& e) {
-        std::cerr << "Syntax error: " << e << "\n";
-        exit(func::error_codes::E_SYTNTAX);
+        if(batch_flag && !settings.llvm_opts.remarks_output.empty()) {
+            std::cerr << "--remarks-output can't be combined with --batch.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+        // Every module would keep its own records, only the one with main writes them
+        if(batch_flag && settings.llvm_opts.instrument_functions) {
+            std::cerr << "--instrument-functions can't be combined with --batch.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+        if(batch_flag && settings.llvm_opts.whole_program) {
+            std::cerr << "--whole-program can't be combined with --batch.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+        if(batch_flag && settings.run) {
+            std::cerr << "--run can't be combined with --batch.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+        // The JIT has no profile runtime to resolve the counters against
+        if(settings.run && !settings.llvm_opts.profile_generate.empty()) {
+            std::cerr << "--run can't be combined with --profile-generate.\n";
+            exit(func::error_codes::E_PARAMS);
+        }
+
+    } catch(const cxxopts::exceptions::exception& e) {
+        std::cerr << "Error parsing options: " << e.what() << '\n';
+        exit(func::error_codes::E_PARAMS);
+    }
+
+    if(!settings.trace_out.empty()) {
+        // Granularity 0 keeps every event, even the shortest passes
+        llvm::timeTraceProfilerInitialize(0, "compiler");
+    }
+
+    int code = 0;
+    if(batch_flag) {
+        if(output_file.empty())
+            output_file = ".";
+        llvm::sys::fs::create_directories(output_file);
+        code = compile_batch(sources, output_file, jobs, settings);
+    } else {
+        code = compile(sources, output_file, settings);
+    }
+
+    int report_code = write_reports(settings);
+    if(!settings.trace_out.empty()) {
+        llvm::timeTraceProfilerCleanup();
     }
+    return code != 0 ? code : report_code;
 }
@@ -6,7 +6,8 @@ driver::driver() = default;
 
 int driver::parse(const std::string& f) {
     file = f;
-    location.initialize(&file);
+    location.initialize(&files.emplace_back(f));
+    func::arena::scope arena_scope{ ast_arena };
     scan_begin();
     yy::parser parser(*this);
     parser.set_debug_level(static_cast<yy::parser::debug_level_type>(trace_parsing));
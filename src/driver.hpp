@@ -3,21 +3,29 @@
 #include "codegen/location.hh"
 #include "codegen/parser.tab.hpp"
 #include "node/ast.hpp"
+#include "source_manager.hpp"
+#include <list>
 #include <memory>
 #include <string>
 
-#define YY_DECL yy::parser::symbol_type yylex(driver& drv)
+#define YY_DECL yy::parser::symbol_type yylex(driver& drv, void* yyscanner)
 YY_DECL;
 
 class driver {
 
     public:
     driver();
+    // Memory of the trees parsed by this driver, declared before result
+    // so that it is released after the tree.
+    func::arena ast_arena;
     std::unique_ptr<func::ast_node> result;
     // Run the parser on file F.  Return 0 on success.
     int parse(const std::string& f);
     // The name of the file being parsed.
     std::string file;
+    // Names of all parsed files. Locations of the resulting trees point
+    // into it, so it has to outlive them.
+    std::list<std::string> files;
     // Whether to generate parser debug traces.
     bool trace_parsing{ false };
     // Handling the scanner.
@@ -25,6 +33,16 @@ class driver {
     void scan_end();
     // Whether to generate scanner debug traces.
     bool trace_scanning{ false };
+    // State of the reentrant scanner, one per driver, so that several
+    // drivers can parse on different threads.
+    void* scanner{ nullptr };
+    // Text of all parsed files, the scanner reads it in place.
+    func::source_manager sources;
     // The token's location used by the scanner.
     yy::location location;
-};
\ No newline at end of file
+};
+
+// The parser calls the scanner of the driver it was created with.
+inline yy::parser::symbol_type yylex(driver& drv) {
+    return yylex(drv, drv.scanner);
+}
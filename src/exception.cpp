@@ -9,4 +9,8 @@ std::ostream& operator<<(std::ostream& outs, const syntax_exception& e) {
 std::ostream& operator<<(std::ostream& outs, const global_syntax_exception& e) {
     return outs << e.reason;
 }
+
+std::ostream& operator<<(std::ostream& outs, const codegen_exception& e) {
+    return outs << e.reason;
+}
 } // namespace func
\ No newline at end of file
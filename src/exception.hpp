@@ -42,6 +42,11 @@ struct global_syntax_exception {
     std::string reason;
 };
 
+struct codegen_exception {
+    std::string reason;
+};
+
 std::ostream& operator<<(std::ostream& outs, const syntax_exception& e);
 std::ostream& operator<<(std::ostream& outs, const global_syntax_exception& e);
+std::ostream& operator<<(std::ostream& outs, const codegen_exception& e);
 } // namespace func
\ No newline at end of file
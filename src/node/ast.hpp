@@ -1,6 +1,7 @@
 #ifndef NODE_AST_HPP_
 #define NODE_AST_HPP_
 
+#include "arena.hpp"
 #include "codegen/location.hh"
 #include "visitor/visitor.hpp"
 #include <memory>
@@ -21,7 +22,8 @@ class visitable_base {
     virtual ~visitable_base() = default;
 };
 
-class ast_node : public visitable_base {
+// Nodes built by the parser live in the arena of the driver
+class ast_node : public visitable_base, public arena_allocated {
     private:
     yy::location loc;
 
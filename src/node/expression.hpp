@@ -2,6 +2,7 @@
 
 #include "codegen/location.hh"
 #include "node/ast.hpp"
+#include "symbol.hpp"
 #include <memory>
 #include <string>
 #include <utility>
@@ -74,12 +75,12 @@ class identifier_expression : public ast_node_impl<identifier_expression> {
     using Base = ast_node_impl<identifier_expression>;
 
     private:
-    std::string identificator;
+    symbol identificator;
 
     public:
-    identifier_expression(std::string identificator, yy::location loc)
-    : Base(loc), identificator(std::move(identificator)) {}
-    const std::string& get_identificator() const { return identificator; }
+    identifier_expression(symbol identificator, yy::location loc)
+    : Base(loc), identificator(identificator) {}
+    const symbol& get_identificator() const { return identificator; }
 };
 
 class subscript_expression : public ast_node_impl<subscript_expression> {
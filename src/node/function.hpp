@@ -4,6 +4,7 @@
 #include "node/ast.hpp"
 #include "node/expression.hpp"
 #include "node/statement.hpp"
+#include "symbol.hpp"
 #include <string>
 
 namespace func {
@@ -26,32 +27,32 @@ class function_call : public ast_node_impl<function_call> {
 };
 
 class parameter {
-    unique_ptr<type> type_obj;
-    std::string identifier;
+    const type* type_obj{ nullptr };
+    symbol identifier;
 
     public:
     parameter() = default;
-    parameter(unique_ptr<type> type_obj, std::string& identifier)
-    : type_obj{ std::move(type_obj) }, identifier{ identifier } {}
-    const unique_ptr<type>& get_type() const { return type_obj; }
-    const std::string& get_identifier() const { return identifier; }
+    parameter(const type* type_obj, symbol identifier)
+    : type_obj{ type_obj }, identifier{ identifier } {}
+    const type* get_type() const { return type_obj; }
+    const symbol& get_identifier() const { return identifier; }
 };
 
 class declaration : public ast_node_impl<declaration> {
     using Base = ast_node_impl<declaration>;
-    unique_ptr<type> result_type;
-    std::string identifier;
+    const type* result_type;
+    symbol identifier;
     std::vector<parameter> param_list;
 
     public:
-    declaration(unique_ptr<type> result_type,
-                std::string& identifier,
+    declaration(const type* result_type,
+                symbol identifier,
                 std::vector<parameter>&& param_list,
                 yy::location loc)
-    : Base{ loc }, result_type{ std::move(result_type) },
+    : Base{ loc }, result_type{ result_type },
       identifier{ identifier }, param_list{ std::move(param_list) } {}
-    const unique_ptr<type>& get_result_type() const { return result_type; }
-    const std::string& get_identifier() const { return identifier; }
+    const type* get_result_type() const { return result_type; }
+    const symbol& get_identifier() const { return identifier; }
     const std::vector<parameter>& get_params() const { return param_list; }
 };
 
@@ -64,10 +65,10 @@ class function : public ast_node_impl<function> {
     function(unique_ptr<declaration> declaration, unique_ptr<block_statement> block, yy::location loc)
     : Base{ loc }, decl{ std::move(declaration) }, block{ std::move(block) } {}
     const unique_ptr<declaration>& get_declaration() const { return decl; }
-    const unique_ptr<type>& get_result_type() const {
+    const type* get_result_type() const {
         return decl->get_result_type();
     }
-    const std::string& get_identifier() const {
+    const symbol& get_identifier() const {
         return decl->get_identifier();
         ;
     }
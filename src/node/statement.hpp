@@ -2,6 +2,7 @@
 #include "codegen/location.hh"
 #include "node/ast.hpp"
 #include "node/expression.hpp"
+#include "symbol.hpp"
 #include "type/type.hpp"
 #include <string>
 #include <utility>
@@ -26,26 +27,26 @@ class assign_statement : public ast_node_impl<assign_statement> {
     using Base = ast_node_impl<assign_statement>;
 
     private:
-    std::string identifier;
+    symbol identifier;
     unique_ptr<ast_node> exp;
-    unique_ptr<type> type_obj;
+    const type* type_obj{ nullptr };
 
     public:
-    assign_statement(unique_ptr<func::type> type, std::string& id, yy::location loc)
-    : Base(loc), identifier(id), type_obj{ std::move(type) } {}
+    assign_statement(const func::type* type, symbol id, yy::location loc)
+    : Base(loc), identifier(id), type_obj{ type } {}
 
-    assign_statement(unique_ptr<func::type> type,
-                     std::string& id,
+    assign_statement(const func::type* type,
+                     symbol id,
                      unique_ptr<ast_node> exp,
                      yy::location loc)
-    : Base(loc), identifier(id), exp(std::move(exp)), type_obj{ std::move(type) } {}
+    : Base(loc), identifier(id), exp(std::move(exp)), type_obj{ type } {}
 
-    assign_statement(std::string& id, unique_ptr<ast_node> exp, yy::location loc)
+    assign_statement(symbol id, unique_ptr<ast_node> exp, yy::location loc)
     : Base(loc), identifier(id), exp(std::move(exp)) {}
 
-    const std::string& get_identifier() const { return identifier; }
+    const symbol& get_identifier() const { return identifier; }
     const unique_ptr<ast_node>& get_exp() const { return exp; }
-    const unique_ptr<type>& get_type() const { return type_obj; }
+    const type* get_type() const { return type_obj; }
 };
 
 class if_statement : public ast_node_impl<if_statement> {
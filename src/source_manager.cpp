@@ -0,0 +1,70 @@
+#include "source_manager.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace func {
+
+source_manager::~source_manager() {
+    for(const auto& m : mappings) {
+        munmap(m.base, m.length);
+    }
+}
+
+std::optional<source_manager::buffer> source_manager::open(const std::string& file) {
+    if(file.empty() || file == "-") {
+        auto& text = copies.emplace_back();
+        int c;
+        while((c = std::getchar()) != EOF) {
+            text.push_back(static_cast<char>(c));
+        }
+        std::size_t size = text.size();
+        text.resize(size + 2, '\0');
+        return buffer{ text.data(), size };
+    }
+
+    int fd = ::open(file.c_str(), O_RDONLY);
+    if(fd < 0)
+        return std::nullopt;
+
+    struct stat st {};
+    if(fstat(fd, &st) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return std::nullopt;
+    }
+    auto size = static_cast<std::size_t>(st.st_size);
+
+    // Reserve zeroed memory with room for the two trailing NULs and map the
+    // file over its start. The rest of the last file page reads as zeros
+    // too, so the text is terminated even when it fills whole pages.
+    std::size_t length = size + 2;
+    void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return std::nullopt;
+    }
+    // The scanner writes into the buffer, private pages keep the file intact
+    if(size > 0 &&
+       mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        int saved = errno;
+        munmap(base, length);
+        close(fd);
+        errno = saved;
+        return std::nullopt;
+    }
+    close(fd);
+
+    mappings.push_back({ base, length });
+    return buffer{ static_cast<char*>(base), size };
+}
+
+} // namespace func
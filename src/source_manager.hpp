@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace func {
+
+// Owns the text of every source a driver parses. Files are mapped into
+// memory instead of being read, and the scanner works on the mapping in
+// place, so tokens are views into it.
+class source_manager {
+    struct mapping {
+        void* base;
+        std::size_t length;
+    };
+    std::vector<mapping> mappings;
+    // Sources that can't be mapped, e.g. stdin
+    std::list<std::vector<char>> copies;
+
+    public:
+    struct buffer {
+        char* data;
+        // Without the two NULs that always follow the text, flex needs them
+        std::size_t size;
+    };
+
+    source_manager() = default;
+    source_manager(const source_manager&) = delete;
+    source_manager& operator=(const source_manager&) = delete;
+    ~source_manager();
+
+    // Maps FILE, "-" or an empty name read stdin. The buffer is private to
+    // this manager and lives as long as it. Returns nullopt with errno set
+    // if the file can't be read.
+    std::optional<buffer> open(const std::string& file);
+};
+
+} // namespace func
@@ -0,0 +1,59 @@
+#include "symbol.hpp"
+
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace func {
+
+namespace {
+
+class symbol_pool {
+    std::shared_mutex mutex;
+    // A deque never moves its elements, the keys of ids view into it
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, uint32_t> ids;
+
+    public:
+    symbol_pool() { intern(""); }
+
+    std::pair<uint32_t, const std::string*> intern(std::string_view name) {
+        {
+            // Most lookups hit an already known name
+            std::shared_lock lock{ mutex };
+            auto iter = ids.find(name);
+            if(iter != ids.end())
+                return { iter->second, &names[iter->second] };
+        }
+        std::unique_lock lock{ mutex };
+        auto iter = ids.find(name);
+        if(iter != ids.end())
+            return { iter->second, &names[iter->second] };
+        auto id = static_cast<uint32_t>(names.size());
+        const std::string& stored = names.emplace_back(name);
+        ids.emplace(stored, id);
+        return { id, &stored };
+    }
+};
+
+symbol_pool& pool() {
+    static symbol_pool instance;
+    return instance;
+}
+
+} // namespace
+
+symbol::symbol() : symbol(std::string_view{}) {}
+
+symbol::symbol(std::string_view name) {
+    auto [interned_id, interned_text] = pool().intern(name);
+    id = interned_id;
+    text = interned_text;
+}
+
+std::ostream& operator<<(std::ostream& os, const symbol& sym) {
+    return os << sym.str();
+}
+
+} // namespace func
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace func {
+
+// Interned identifier. Equal names share one id, so comparing and hashing
+// symbols never looks at the characters. The pool is global, shared by all
+// threads and never shrinks, so a symbol stays valid for the whole run.
+class symbol {
+    uint32_t id;
+    const std::string* text;
+
+    public:
+    // The empty name
+    symbol();
+    explicit symbol(std::string_view name);
+
+    uint32_t get_id() const { return id; }
+    const std::string& str() const { return *text; }
+
+    bool operator==(const symbol& other) const { return id == other.id; }
+    bool operator!=(const symbol& other) const { return id != other.id; }
+};
+
+std::ostream& operator<<(std::ostream& os, const symbol& sym);
+
+} // namespace func
+
+template <> struct std::hash<func::symbol> {
+    std::size_t operator()(const func::symbol& sym) const noexcept { return sym.get_id(); }
+};
@@ -0,0 +1,186 @@
+#include "time_report.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+
+namespace func {
+
+namespace {
+
+double wall_now_ms() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+double cpu_now_ms() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e3 + static_cast<double>(ts.tv_nsec) / 1e6;
+}
+
+struct frame {
+    time_report* report;
+    size_t index;
+    double wall_start;
+    double cpu_start;
+    // Spent in the phases nested into this one
+    double child_wall{ 0 };
+    double child_cpu{ 0 };
+};
+
+thread_local std::vector<frame> active_phases;
+
+std::string json_escape(const std::string& str) {
+    std::string res;
+    for(char c : str) {
+        if(c == '"' || c == '\\')
+            res.push_back('\\');
+        res.push_back(c);
+    }
+    return res;
+}
+
+struct report_parts {
+    std::vector<time_report::entry> phases;
+    std::vector<time_report::entry> passes;
+    double total_wall{ 0 };
+    double total_cpu{ 0 };
+};
+
+report_parts split_entries(const std::vector<time_report::entry>& entries) {
+    report_parts parts;
+    for(const auto& e : entries) {
+        bool is_phase = e.category == time_report::kind::PHASE;
+        (is_phase ? parts.phases : parts.passes).push_back(e);
+        parts.total_wall += e.wall_ms;
+        parts.total_cpu += e.cpu_ms;
+    }
+    return parts;
+}
+
+void print_entries(std::ostream& os, const std::vector<time_report::entry>& entries, const char* title) {
+    if(entries.empty())
+        return;
+    os << "   Wall (ms)    CPU (ms)    Calls  " << title << "\n";
+    for(const auto& e : entries) {
+        os << std::setw(12) << e.wall_ms << std::setw(12) << e.cpu_ms << std::setw(9)
+           << e.calls << "  " << e.name << "\n";
+    }
+    os << "\n";
+}
+
+void print_json_entries(std::ostream& os, const std::vector<time_report::entry>& entries) {
+    os << "[";
+    for(size_t i = 0; i < entries.size(); i++) {
+        const auto& e = entries[i];
+        os << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << json_escape(e.name)
+           << "\", \"calls\": " << e.calls << ", \"wall_ms\": " << e.wall_ms
+           << ", \"cpu_ms\": " << e.cpu_ms << " }";
+    }
+    os << (entries.empty() ? "]" : "\n  ]");
+}
+
+} // namespace
+
+time_report::scope::scope(time_report* report, std::string_view name, kind category)
+: report{ report } {
+    if(report != nullptr)
+        report->begin(name, category);
+}
+
+time_report::scope::~scope() {
+    if(report != nullptr)
+        report->end();
+}
+
+void time_report::begin(std::string_view name, kind category) {
+    size_t index = find_entry(name, category);
+    active_phases.push_back(frame{ this, index, wall_now_ms(), cpu_now_ms() });
+}
+
+void time_report::end() {
+    assert(!active_phases.empty() && active_phases.back().report == this);
+    frame f = active_phases.back();
+    active_phases.pop_back();
+
+    double wall = wall_now_ms() - f.wall_start;
+    double cpu = cpu_now_ms() - f.cpu_start;
+    if(!active_phases.empty()) {
+        active_phases.back().child_wall += wall;
+        active_phases.back().child_cpu += cpu;
+    }
+    record(f.index, wall - f.child_wall, cpu - f.child_cpu);
+}
+
+void time_report::add_count(const std::string& name, uint64_t count) {
+    std::lock_guard lock{ mutex };
+    auto iter = std::find_if(counters.begin(), counters.end(),
+                             [&name](const auto& c) { return c.first == name; });
+    if(iter == counters.end())
+        counters.emplace_back(name, count);
+    else
+        iter->second += count;
+}
+
+size_t time_report::find_entry(std::string_view name, kind category) {
+    std::string key = (category == kind::PASS ? "pass:" : "phase:") + std::string{ name };
+    std::lock_guard lock{ mutex };
+    auto iter = entry_index.find(key);
+    if(iter != entry_index.end())
+        return iter->second;
+    entries.push_back(entry{ category, std::string{ name } });
+    entry_index.emplace(std::move(key), entries.size() - 1);
+    return entries.size() - 1;
+}
+
+void time_report::record(size_t index, double wall_ms, double cpu_ms) {
+    std::lock_guard lock{ mutex };
+    auto& e = entries[index];
+    e.calls++;
+    e.wall_ms += wall_ms;
+    e.cpu_ms += cpu_ms;
+}
+
+void time_report::print(std::ostream& os) const {
+    std::lock_guard lock{ mutex };
+    auto [phases, passes, total_wall, total_cpu] = split_entries(entries);
+    // The expensive passes first, phases keep the order they ran in
+    std::stable_sort(passes.begin(), passes.end(),
+                     [](const entry& a, const entry& b) { return a.wall_ms > b.wall_ms; });
+
+    auto flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+    os << "===- Time report -===\n";
+    os << "  Total: " << total_wall << " ms wall, " << total_cpu << " ms cpu\n\n";
+    print_entries(os, phases, "Phase");
+    print_entries(os, passes, "LLVM pass");
+    for(const auto& [name, count] : counters) {
+        os << std::setw(12) << count << "  " << name << "\n";
+    }
+    os.flags(flags);
+}
+
+void time_report::print_json(std::ostream& os) const {
+    std::lock_guard lock{ mutex };
+    auto [phases, passes, total_wall, total_cpu] = split_entries(entries);
+
+    auto flags = os.flags();
+    os << std::fixed << std::setprecision(3);
+    os << "{\n  \"total\": { \"wall_ms\": " << total_wall << ", \"cpu_ms\": " << total_cpu
+       << " },\n  \"phases\": ";
+    print_json_entries(os, phases);
+    os << ",\n  \"passes\": ";
+    print_json_entries(os, passes);
+    os << ",\n  \"counters\": {";
+    for(size_t i = 0; i < counters.size(); i++) {
+        os << (i == 0 ? " " : ", ") << "\"" << json_escape(counters[i].first)
+           << "\": " << counters[i].second;
+    }
+    os << " }\n}\n";
+    os.flags(flags);
+}
+
+} // namespace func
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace func {
+
+// Wall and CPU time spent in the phases of a compilation, plus counters of
+// what was processed. Phases nest per thread, and the time of a phase
+// excludes the phases started inside it, so the entries sum up to the total.
+// CPU time is the time of the calling thread, so --batch workers can
+// share one report.
+class time_report {
+    public:
+    enum class kind : char { PHASE, PASS };
+
+    struct entry {
+        kind category;
+        std::string name;
+        uint64_t calls{ 0 };
+        double wall_ms{ 0 };
+        double cpu_ms{ 0 };
+    };
+
+    // Times its lifetime as the phase NAME, does nothing for a null report.
+    class scope {
+        time_report* report;
+
+        public:
+        scope(time_report* report, std::string_view name, kind category = kind::PHASE);
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+        ~scope();
+    };
+
+    // Starts and stops a phase on the calling thread, for callers that
+    // can't hold a scope, e.g. LLVM pass instrumentation.
+    void begin(std::string_view name, kind category);
+    void end();
+
+    void add_count(const std::string& name, uint64_t count);
+
+    void print(std::ostream& os) const;
+    void print_json(std::ostream& os) const;
+
+    private:
+    mutable std::mutex mutex;
+    // In order of the first run
+    std::vector<entry> entries;
+    std::unordered_map<std::string, size_t> entry_index;
+    std::vector<std::pair<std::string, uint64_t>> counters;
+
+    size_t find_entry(std::string_view name, kind category);
+    void record(size_t index, double wall_ms, double cpu_ms);
+};
+
+} // namespace func
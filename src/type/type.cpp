@@ -1,38 +1,51 @@
 #include "type.hpp"
+#include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 namespace func {
 
-const std::vector<std::unique_ptr<type>>& function_type::get_signature() const {
+const std::vector<const type*>& function_type::get_signature() const {
     return signature;
 }
-function_type::function_type(std::vector<std::unique_ptr<type>>&& sign)
+function_type::function_type(std::vector<const type*> sign)
 : signature{ std::move(sign) } {}
 
-function_type::function_type(const function_type& t) {
-    signature.reserve(t.signature.size());
-    for(const auto& a : t.signature) {
-        signature.push_back(a ? a->clone() : nullptr);
-    }
-}
+namespace {
 
-bool function_type::equals(const type& f) const {
-    if(f.get_type() != types::FUNCTION)
-        return false;
-    const auto& func = dynamic_cast<const function_type&>(f);
-    if(signature.size() != func.signature.size())
-        return false;
-    for(int i = 0; i < signature.size(); i++) {
-        type const& func_cur_type = *func.signature[i];
-        if(!signature[i]->equals(func_cur_type))
-            return false;
+class function_type_pool {
+    std::shared_mutex mutex;
+    // Signatures consist of already interned types, so comparing them
+    // element by element compares addresses only
+    std::map<std::vector<const type*>, std::unique_ptr<function_type>> types;
+
+    public:
+    template <typename Make>
+    const function_type* intern(std::vector<const type*>&& signature, Make make) {
+        {
+            std::shared_lock lock{ mutex };
+            auto iter = types.find(signature);
+            if(iter != types.end())
+                return iter->second.get();
+        }
+        std::unique_lock lock{ mutex };
+        auto iter = types.find(signature);
+        if(iter != types.end())
+            return iter->second.get();
+        auto key = signature;
+        auto [inserted, _] = types.emplace(std::move(key), make(std::move(signature)));
+        return inserted->second.get();
     }
-    return true;
+};
+
+function_type_pool& function_types() {
+    static function_type_pool instance;
+    return instance;
 }
-namespace {
 
 std::unordered_map<func::types, std::string> type_name_for_expect = {
     { func::types::INT, "int" },
@@ -43,8 +56,34 @@ std::unordered_map<func::types, std::string> type_name_for_expect = {
 };
 };
 
+const int_type* type_context::get_int() {
+    static const int_type instance;
+    return &instance;
+}
+
+const string_type* type_context::get_string() {
+    static const string_type instance;
+    return &instance;
+}
+
+const bool_type* type_context::get_bool() {
+    static const bool_type instance;
+    return &instance;
+}
+
+const void_type* type_context::get_void() {
+    static const void_type instance;
+    return &instance;
+}
+
+const function_type* type_context::get_function(std::vector<const type*> signature) {
+    return function_types().intern(std::move(signature), [](std::vector<const type*>&& sign) {
+        return std::unique_ptr<function_type>{ new function_type{ std::move(sign) } };
+    });
+}
+
 std::string types_to_string(const func::types t) {
-    return func::type_name_for_expect[t];
+    return func::type_name_for_expect.at(t);
 }
 
 // NOLINTNEXTLINE(misc-no-recursion)
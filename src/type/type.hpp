@@ -1,29 +1,32 @@
 #pragma once
 
-#include <memory>
 #include <string>
 #include <vector>
 namespace func {
 
 enum class types : char { INT, STRING, BOOL, VOID, FUNCTION };
 
+class type_context;
+
+// Types are interned by type_context: two structurally equal types are the
+// same object, so they are compared by address and passed around as
+// non-owning pointers.
 class type {
     public:
     virtual types get_type() const = 0;
-    virtual std::unique_ptr<type> clone() const = 0;
     virtual ~type() = default;
-    virtual bool equals(const type& t) const {
-        return get_type() == t.get_type();
-    }
+
+    type(const type&) = delete;
+    type& operator=(const type&) = delete;
+
+    protected:
+    type() = default;
 };
 
 template <typename Derived, types Tp> class type_impl : public type {
     public:
     static const types type_enum = Tp;
     types get_type() const override { return Tp; }
-    std::unique_ptr<type> clone() const override {
-        return std::make_unique<Derived>(static_cast<const Derived&>(*this));
-    }
 
     private:
     type_impl() = default;
@@ -34,39 +37,60 @@ std::string types_to_string(func::types t);
 std::string type_to_string(const func::type& t);
 
 class int_type : public type_impl<int_type, types::INT> {
+    int_type() = default;
+    friend type_context;
+
     public:
     using type_impl::type_enum;
 };
 
 class string_type : public type_impl<string_type, types::STRING> {
+    string_type() = default;
+    friend type_context;
+
     public:
     using type_impl::type_enum;
 };
 
 class bool_type : public type_impl<bool_type, types::BOOL> {
+    bool_type() = default;
+    friend type_context;
+
     public:
     using type_impl::type_enum;
 };
 
 class void_type : public type_impl<void_type, types::VOID> {
+    void_type() = default;
+    friend type_context;
+
     public:
     using type_impl::type_enum;
 };
 
 class function_type : public type_impl<function_type, types::FUNCTION> {
-    std::vector<std::unique_ptr<type>> signature;
+    // Parameter types followed by the return type
+    std::vector<const type*> signature;
 
-    public:
-    function_type(const function_type&);
+    explicit function_type(std::vector<const type*> sign);
+    friend type_context;
 
     public:
     using type_impl::type_enum;
-    function_type(std::vector<std::unique_ptr<type>>&& sign);
-    const std::vector<std::unique_ptr<type>>& get_signature() const;
-    const std::unique_ptr<type>& get_return_type() const {
-        return signature.back();
-    }
-    bool equals(const type& f) const override;
+    const std::vector<const type*>& get_signature() const;
+    const type* get_return_type() const { return signature.back(); }
+};
+
+// Owns every type of the run. The primitive types are singletons and
+// function types are uniqued by signature. The context is global and shared
+// by all threads, types are never freed.
+class type_context {
+    public:
+    static const int_type* get_int();
+    static const string_type* get_string();
+    static const bool_type* get_bool();
+    static const void_type* get_void();
+    static const function_type* get_function(std::vector<const type*> signature);
 };
 
 } // namespace func
@@ -5,11 +5,11 @@
 
 namespace func {
 
-void expect_types(const type& expected, const type& checked, yy::location loc) {
-    if(!expected.equals(checked))
-        throw unexpected_type_exception{ "expected " + func::type_to_string(expected) +
-                                         " but received " + func::type_to_string(checked),
+void expect_types(const type* expected, const type* checked, yy::location loc) {
+    if(expected != checked)
+        throw unexpected_type_exception{ "expected " + func::type_to_string(*expected) +
+                                         " but received " + func::type_to_string(*checked),
                                          loc };
 }
 
-} // namespace func
\ No newline at end of file
+} // namespace func
@@ -4,6 +4,7 @@
 #include "type/type.hpp"
 namespace func {
 
-void expect_types(const type& expected, const type& checked, yy::location loc);
+// Types are interned, so this is a pointer comparison
+void expect_types(const type* expected, const type* checked, yy::location loc);
 
-}
\ No newline at end of file
+}
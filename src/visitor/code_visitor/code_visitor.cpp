@@ -12,39 +12,41 @@
 #include "visitor/code_visitor/operation.hpp"
 #include "visitor/code_visitor/register_allocator.hpp"
 
+#include <llvm/Support/TimeProfiler.h>
+
+#include <algorithm>
 #include <cstdint>
 #include <memory>
 
 namespace func {
 
+namespace {
+// Registers a single operation takes at most: both operands, the result
+// and a scratch register
+const uint32_t op_registers = 4;
+} // namespace
+
 code_visitor::code_visitor(func::printer& printer)
-: debug_out{ printer.debug }, alloc{ printer.alloc }, writer{ printer.code } {}
+: writer{ printer.code }, debug_out{ writer.comment_stream(), printer.print_debug },
+  alloc_out{ writer.comment_stream(), printer.print_alloc }, alloc{ alloc_out } {}
 
 void code_visitor::declare_write_func() {
-    auto func_addr = writer.get_next_addr();
+    writer.write_func();
 
-    writer.write_func(alloc);
-
-    std::vector<unique_ptr<func::type>> write_sign;
-    write_sign.push_back(std::make_unique<int_type>());
-    write_sign.push_back(std::make_unique<void_type>());
-    auto info =
-    sym_info{ "write", std::make_unique<func::function_type>(std::move(write_sign)),
-              sym_info::ABS, func_addr };
+    auto info = sym_info{ symbol{ "write" },
+                          type_context::get_function({ type_context::get_int(),
+                                                       type_context::get_void() }),
+                          "WRITE" };
     table.add(std::move(info));
 }
 
 void code_visitor::declare_read_func() {
-    auto func_addr = writer.get_next_addr();
-
-    writer.read_func(alloc);
+    writer.read_func();
 
-    std::vector<unique_ptr<func::type>> read_sign;
-    read_sign.push_back(std::make_unique<void_type>());
-    read_sign.push_back(std::make_unique<int_type>());
-    auto info =
-    sym_info{ "read", std::make_unique<func::function_type>(std::move(read_sign)),
-              sym_info::ABS, func_addr };
+    auto info = sym_info{ symbol{ "read" },
+                          type_context::get_function({ type_context::get_void(),
+                                                       type_context::get_int() }),
+                          "READ" };
     table.add(std::move(info));
 }
 
@@ -53,11 +55,7 @@ void code_visitor::visit(const program& progr) {
     writer.label("_START");
     writer.li(instr::SP, (1 << 16));
     writer.li(instr::BP, (1 << 16));
-    auto r = alloc.alloc("Store addres for main");
-    writer.li_label(r, "main");
-    writer.call_start(alloc, 0);
-    writer.call_end(r);
-    alloc.dealloc(r);
+    writer.call("main");
     writer.ebreak();
 
     declare_write_func();
@@ -70,12 +68,10 @@ void code_visitor::visit(const program& progr) {
 
     // Main type & existance check
 
-    const auto& main_info = table.find("main");
-    std::vector<unique_ptr<type>> types_vec{};
-    types_vec.push_back(std::make_unique<void_type>());
-    types_vec.push_back(std::make_unique<void_type>());
-    const function_type main_expected_type = function_type{ std::move(types_vec) };
-    if(!main_info.type_obj->equals(main_expected_type))
+    const auto& main_info = table.find(symbol{ "main" });
+    const auto* main_expected_type =
+    type_context::get_function({ type_context::get_void(), type_context::get_void() });
+    if(main_info.type_obj != main_expected_type)
         throw global_syntax_exception{ "main must be a (void-void) function" };
 
     debug_out << "# Done program\n";
@@ -84,24 +80,25 @@ void code_visitor::visit(const program& progr) {
 void code_visitor::visit(const declaration& d) {
     debug_out << "# Enter declaration " << d.get_identifier() << "\n";
 
-    auto signature = std::vector<unique_ptr<type>>();
+    auto signature = std::vector<const type*>();
     if(d.get_params().empty())
-        signature.push_back(std::make_unique<void_type>());
+        signature.push_back(type_context::get_void());
     else
         for(const auto& p : d.get_params()) {
-            signature.push_back(p.get_type()->clone());
+            signature.push_back(p.get_type());
         }
-    signature.push_back(d.get_result_type()->clone());
+    signature.push_back(d.get_result_type());
 
     auto info = sym_info{ d.get_identifier(),
-                          std::make_unique<func::function_type>(std::move(signature)),
-                          sym_info::ABS, writer.get_next_addr() };
+                          type_context::get_function(std::move(signature)),
+                          d.get_identifier().str() };
     table.add(std::move(info));
 
     debug_out << "# Done declaration " << d.get_identifier() << "\n";
 }
 
 void code_visitor::visit(const function& f) {
+    llvm::TimeTraceScope trace{ "Codegen function", f.get_identifier().str() };
     debug_out << "# Enter function " << f.get_identifier() << "\n";
 
     f.get_declaration()->accept(*this);
@@ -110,46 +107,156 @@ void code_visitor::visit(const function& f) {
     if(f.get_block() == nullptr) {
         throw syntax_exception{ "unsupported operation 'function declaration' "
                                 "of '" +
-                                f.get_identifier() + "' for emulator",
+                                f.get_identifier().str() + "' for emulator",
                                 f.get_loc() };
     }
+    order = std::make_unique<evaluation_order>(f);
+    // Temporaries keep the registers the expressions need, up to half of
+    // the caller-saved ones: a rare large expression spills rather than
+    // taking the registers from the variables
+    uint8_t temporaries = std::clamp<uint32_t>(order->max_registers_needed(), op_registers,
+                                               reg_allocator::LAST_CALLER_SAVED / 2);
+    uint8_t caller_saved = std::min<uint8_t>(reg_allocator::CALLER_SAVED_VARIABLE_NUM,
+                                             reg_allocator::LAST_CALLER_SAVED - temporaries);
+    promotion = std::make_unique<local_promotion>(f, *order, caller_saved,
+                                                  reg_allocator::CALLEE_SAVED_NUM);
+    free_spill_slots.clear();
     // Staring block for func param
     table.start_block();
 
-    for(int i = 0; i < f.get_params().size(); i++) {
-        const auto& param = f.get_params()[i];
+    const auto& params = f.get_params();
+    for(int i = 0; i < params.size(); i++) {
+        const auto& param = params[i];
 
         // Registering parameters
-        table.add(sym_info{ param.get_identifier(), param.get_type()->clone(),
-                            sym_info::STACK, static_cast<uint16_t>(i + 1) });
+        auto sym = sym_info{ param.get_identifier(), param.get_type(), sym_info::STACK,
+                             static_cast<uint16_t>(i + 1) };
+        auto place = promotion->place(i);
+        if(place != local_promotion::placement::STACK) {
+            sym.access_type = sym_info::REG;
+            sym.reg = pin_variable(param.get_identifier(), place);
+        }
+        table.add(std::move(sym));
+    }
+    // The registers of the locals are known now, as the ones the function
+    // saves
+    for(auto [decl, place] : promotion->promoted_locals())
+        local_regs[decl] = pin_variable(decl->get_identifier(), place);
+
+    // Parameter I has slot I + 1 below BP, up to the last one kept there or
+    // passed there, then come the saved registers, the locals on the stack
+    // and the spill slots. The whole frame is reserved at once, so a slot
+    // is where its offset says whatever path led to it.
+    uint16_t param_slots = 0;
+    for(int i = 0; i < params.size(); i++) {
+        if(i >= reg_allocator::ARG_REGISTER_NUM ||
+           promotion->place(i) == local_promotion::placement::STACK)
+            param_slots = i + 1;
+    }
+    writer.label(f.get_identifier().str());
+    writer.enter();
+    auto frame = writer.frame_step();
+    this->stack_height = param_slots;
+    for(auto r : pinned_regs) {
+        if(!reg_allocator::is_callee_saved(r))
+            continue;
+        saved_regs.emplace_back(r, ++stack_height);
+        writer.put_arg(r, stack_height);
+    }
+    // The caller left the first arguments in registers and the rest in
+    // their slots
+    for(int i = 0; i < params.size(); i++) {
+        const auto& sym = table.find(params[i].get_identifier());
+        if(i < reg_allocator::ARG_REGISTER_NUM) {
+            auto arg = reg_allocator::arg_register(i);
+            if(sym.access_type == sym_info::REG)
+                writer.mov(sym.reg, arg);
+            else
+                writer.put_arg(arg, sym.offset);
+        } else if(sym.access_type == sym_info::REG) {
+            writer.get_arg(sym.reg, sym.offset);
+        }
     }
-
-    writer.label(f.get_identifier());
-    this->stack_height = f.get_params().size();
     f.get_block()->accept(*this);
+    writer.set_frame_size(frame, stack_height);
 
     // Ending block for func param
     table.end_block();
+    for(auto r : pinned_regs)
+        alloc.unpin(r);
+    pinned_regs.clear();
+    local_regs.clear();
+    saved_regs.clear();
     debug_out << "# Done function " << f.get_identifier() << "\n";
 }
 
+void code_visitor::make_room(const std::vector<held_value*>& held, const ast_node& next) {
+    uint32_t needed = std::max(order->registers_needed(next), op_registers);
+    for(auto* v : held) {
+        if(alloc.free_count() >= needed)
+            return;
+        // Spilling a borrowed variable frees nothing
+        if(v->slot == 0 && !alloc.is_pinned(v->res.reg_num))
+            spill(*v);
+    }
+}
+
+void code_visitor::spill(held_value& v) {
+    if(free_spill_slots.empty()) {
+        v.slot = ++stack_height;
+    } else {
+        v.slot = free_spill_slots.back();
+        free_spill_slots.pop_back();
+    }
+    debug_out << "# Spill to slot " << v.slot << "\n";
+    writer.put_arg(v.res.reg_num, v.slot);
+    alloc.dealloc(v.res.reg_num);
+}
+
+void code_visitor::reload(held_value& v) {
+    v.res.reg_num = alloc.alloc("Reload spilled value");
+    reload_into(v, v.res.reg_num);
+}
+
+void code_visitor::reload_into(held_value& v, uint8_t reg) {
+    writer.get_arg(reg, v.slot);
+    free_spill_slots.push_back(v.slot);
+    v.slot = 0;
+}
+
+uint8_t code_visitor::pin_variable(const symbol& name, local_promotion::placement place) {
+    auto r = alloc.pin(place == local_promotion::placement::CALLEE_SAVED, "Variable " + name.str());
+    pinned_regs.push_back(r);
+    return r;
+}
+
 void code_visitor::visit(const block_statement& b) {
     debug_out << "# Enter block " << "\n";
     table.start_block();
 
     for(const auto& st : b.get_statements()) {
         st->accept(*this);
+        // A call made for its effect leaves an unused result
+        if(dynamic_cast<const function_call*>(st.get()) != nullptr)
+            alloc.dealloc(result.reg_num);
     }
     table.end_block();
     debug_out << "# Done block " << "\n";
 }
 
 namespace {
-std::vector<uint8_t>
-push_regs_before_call(instr::instruction_writer& w, reg_allocator& alloc) {
-    auto regs = alloc.get_allocated_regs();
-    for(auto r : regs) {
+// Saves the caller-saved registers in use, but the ones only the call
+// itself reads, the function and the arguments
+std::vector<uint8_t> push_regs_before_call(instr::instruction_writer& w,
+                                           reg_allocator& alloc,
+                                           const std::vector<uint8_t>& consumed) {
+    std::vector<uint8_t> regs;
+    for(auto r : alloc.get_allocated_regs()) {
+        auto uses = std::count(consumed.begin(), consumed.end(), r);
+        if(uses > 0 && uses == alloc.use_count(r))
+            continue;
         w.push(r);
+        regs.push_back(r);
     }
     return regs;
 }
@@ -165,7 +272,8 @@ void pop_regs_after_call(instr::instruction_writer& w, std::vector<uint8_t>& reg
 void load_variable(instr::instruction_writer& writer, uint8_t d, sym_info& sym) {
     switch(sym.access_type) {
     case sym_info::STACK: writer.get_arg(d, sym.offset); break;
-    case sym_info::ABS: writer.li(d, sym.offset); break;
+    case sym_info::ABS: writer.la(d, sym.label); break;
+    case sym_info::REG: writer.mov(d, sym.reg); break;
     }
 }
 
@@ -175,25 +283,51 @@ void store_variable(instr::instruction_writer& writer,
                     const sym_info& sym) {
     switch(sym.access_type) {
     case sym_info::STACK: writer.put_arg(s, sym.offset); break;
-    case sym_info::ABS:
+    case sym_info::ABS: {
         auto r = alloc.alloc("Address of variable to store");
-        writer.li(r, sym.offset);
+        writer.la(r, sym.label);
         writer.sw(r, 0, s);
         alloc.dealloc(r);
         break;
     }
+    case sym_info::REG:
+        // Compute the value right into the variable when possible
+        if(alloc.is_pinned(s) || !writer.retarget(s, sym.reg))
+            writer.mov(sym.reg, s);
+        break;
+    }
 }
 
 } // namespace
 void code_visitor::visit(const function_call& fc) {
     debug_out << "# Enter function call" << "\n";
 
-    expr_result func = fc.get_func()->accept_with_result(*this);
+    const auto& args = fc.get_arg_list();
+    // A function called by its name is jumped to directly, not through a register
+    const sym_info* direct = nullptr;
+    if(auto* id = dynamic_cast<const identifier_expression*>(fc.get_func().get())) {
+        const auto& sym = table.find(id->get_identificator());
+        if(sym.access_type == sym_info::ABS)
+            direct = &sym;
+    }
 
-    const auto& func_type = dynamic_cast<const function_type&>(*func.type_obj);
+    // The arguments followed by the function
+    std::vector<held_value> operands(args.size() + 1);
+    std::vector<held_value*> held;
+    for(size_t k : order->operand_order(fc)) {
+        if(k == args.size() && direct != nullptr)
+            continue;
+        const ast_node& exp = k == args.size() ? *fc.get_func() : *args[k];
+        make_room(held, exp);
+        exp.accept(*this);
+        operands[k] = held_value{ result };
+        held.push_back(&operands[k]);
+    }
+    held_value& func = operands.back();
+    if(direct != nullptr)
+        func.res.type_obj = direct->type_obj;
 
-    std::vector<uint8_t> arg_regs{};
-    const auto& args = fc.get_arg_list();
+    const auto& func_type = dynamic_cast<const function_type&>(*func.res.type_obj);
 
     auto params_sz = func_type.get_signature().front()->get_type() == types::VOID ?
     0 :
@@ -205,32 +339,65 @@ void code_visitor::visit(const function_call& fc) {
                                 ", but got " + std::to_string(args_sz),
                                 fc.get_loc() };
 
-    for(int i = 0; i < fc.get_arg_list().size(); i++) {
-        args[i]->accept(*this);
-
-        func::expect_types(*func_type.get_signature()[i], *result.type_obj,
-                           args[i]->get_loc());
-
-        arg_regs.push_back(this->result.reg_num);
+    std::vector<uint8_t> consumed;
+    for(int i = 0; i < operands.size(); i++) {
+        if(i < args_sz)
+            func::expect_types(func_type.get_signature()[i], operands[i].res.type_obj,
+                               args[i]->get_loc());
+        if(operands[i].slot == 0 && (i < args_sz || direct == nullptr))
+            consumed.push_back(operands[i].res.reg_num);
     }
 
     debug_out << "# Pushing regs" << "\n";
-    auto regs = push_regs_before_call(writer, alloc);
-    stack_height += regs.size();
-
-    writer.call_start(alloc, arg_regs.size());
-    for(auto& arg : arg_regs) {
-        writer.push(arg);
-        alloc.dealloc(arg);
+    auto regs = push_regs_before_call(writer, alloc, consumed);
+
+    // Arguments past the argument registers go to their slots in the frame
+    // of the function, below SP until it moves SP over them
+    size_t reg_args = std::min<size_t>(args_sz, reg_allocator::ARG_REGISTER_NUM);
+    for(size_t i = reg_args; i < args_sz; i++) {
+        auto r = operands[i].res.reg_num;
+        if(operands[i].slot != 0) {
+            r = instr::RR;
+            reload_into(operands[i], r);
+        }
+        writer.put_callee_arg(r, i + 1);
+    }
+    // The others go to the argument registers. The function stays where it
+    // is unless that's one of them, then it goes to a caller-saved register
+    // no move reads, whatever the register held is saved or dead by now.
+    std::vector<std::pair<uint8_t, uint8_t>> moves;
+    for(size_t i = 0; i < reg_args; i++) {
+        if(operands[i].slot == 0)
+            moves.emplace_back(reg_allocator::arg_register(i), operands[i].res.reg_num);
+    }
+    auto func_reg = func.res.reg_num;
+    if(direct == nullptr && (func.slot != 0 || func_reg <= reg_args)) {
+        func_reg = reg_allocator::arg_register(reg_args);
+        while(std::any_of(moves.begin(), moves.end(),
+                          [func_reg](const auto& m) { return m.second == func_reg; }))
+            func_reg++;
+        if(func.slot == 0)
+            moves.emplace_back(func_reg, func.res.reg_num);
+    }
+    writer.parallel_move(std::move(moves));
+    for(size_t i = 0; i < reg_args; i++) {
+        if(operands[i].slot != 0)
+            reload_into(operands[i], reg_allocator::arg_register(i));
+    }
+    if(direct != nullptr) {
+        writer.call(direct->label);
+    } else {
+        if(func.slot != 0)
+            reload_into(func, func_reg);
+        writer.call_indirect(func_reg);
     }
-    writer.call_end(func.reg_num);
-    alloc.dealloc(func.reg_num);
+    for(auto r : consumed)
+        alloc.dealloc(r);
 
     debug_out << "# Recovering regs" << "\n";
     pop_regs_after_call(writer, regs);
-    stack_height -= regs.size();
 
-    this->result.type_obj = (func_type).get_signature().back()->clone();
+    this->result.type_obj = (func_type).get_signature().back();
 
     auto r = alloc.alloc("Get function result from RR");
     writer.mov(r, instr::RR);
@@ -242,10 +409,15 @@ void code_visitor::visit(const function_call& fc) {
 void code_visitor::visit(const identifier_expression& id) {
     debug_out << "# Enter identifier " << id.get_identificator() << "\n";
     auto sym = table.find(id.get_identificator());
-    auto r = alloc.alloc("Identifier return register");
-    load_variable(writer, r, sym);
-    this->result.reg_num = r;
-    this->result.type_obj = sym.type_obj->clone();
+    if(sym.access_type == sym_info::REG) {
+        // Read in place, nothing writes the variable while it's borrowed
+        this->result.reg_num = alloc.borrow(sym.reg);
+    } else {
+        auto r = alloc.alloc("Identifier return register");
+        load_variable(writer, r, sym);
+        this->result.reg_num = r;
+    }
+    this->result.type_obj = sym.type_obj;
 
     debug_out << "# Done identifier " << id.get_identificator() << "\n";
 };
@@ -257,15 +429,15 @@ void code_visitor::visit(const literal_expression& lit) {
 
     if(auto* v = std::get_if<int>(&val)) {
         writer.li(r, *v);
-        result.type_obj = std::make_unique<int_type>();
+        result.type_obj = type_context::get_int();
     } else if(auto* v = std::get_if<bool>(&val)) {
         writer.li(r, *v ? 1 : 0);
-        result.type_obj = std::make_unique<bool_type>();
+        result.type_obj = type_context::get_bool();
     } else if(auto* v = std::get_if<std::string>(&val)) {
+        // Below the frame, every evaluation gets its own copy
         writer.push_str(alloc, *v);
-        this->stack_height += (v->length()) + 1;
         writer.mov(r, instr::SP);
-        result.type_obj = std::make_unique<string_type>();
+        result.type_obj = type_context::get_string();
     }
 
     result.reg_num = r;
@@ -279,14 +451,32 @@ void code_visitor::visit(const return_statement& ret) {
         writer.mov(instr::RR, result.reg_num);
         alloc.dealloc(result.reg_num);
     }
+    for(auto [reg, slot] : saved_regs)
+        writer.get_arg(reg, slot);
     writer.ret(alloc);
     debug_out << "# Done return" << "\n";
 };
 
 void code_visitor::visit(const binop_expression& bop) {
+    if(bop.get_op() == binop::OR || bop.get_op() == binop::AND) {
+        short_circuit(bop);
+        return;
+    }
+
     debug_out << "# Enter binop" << "\n";
-    expr_result left = bop.get_left()->accept_with_result(*this);
-    expr_result right = bop.get_right()->accept_with_result(*this);
+    // The operand needing more registers goes first
+    bool swap = order->right_first(bop);
+    const ast_node& first_exp = swap ? *bop.get_right() : *bop.get_left();
+    const ast_node& second_exp = swap ? *bop.get_left() : *bop.get_right();
+    first_exp.accept(*this);
+    held_value first{ result };
+    make_room({ &first }, second_exp);
+    second_exp.accept(*this);
+    expr_result second = result;
+    if(first.slot != 0)
+        reload(first);
+    expr_result left = swap ? second : first.res;
+    expr_result right = swap ? first.res : second;
     try {
         switch(bop.get_op()) {
         case binop::ADD:
@@ -317,11 +507,7 @@ void code_visitor::visit(const binop_expression& bop) {
             this->result = expr_neq(writer, alloc, left, right);
             break;
         case binop::OR:
-            this->result = expr_or(writer, alloc, left, right);
-            break;
-        case binop::AND:
-            this->result = expr_and(writer, alloc, left, right);
-            break;
+        case binop::AND: break; // short_circuit
         }
     } catch(unexpected_type_exception& e) {
         e.loc = bop.get_loc();
@@ -332,6 +518,46 @@ void code_visitor::visit(const binop_expression& bop) {
     debug_out << "# Done binop" << "\n";
 };
 
+void code_visitor::short_circuit(const binop_expression& bop) {
+    debug_out << "# Enter short circuit" << "\n";
+    std::string end_label = "LOGIC_END_" + std::to_string(label_ind++);
+
+    // The left operand register holds the result: it already has the
+    // value when the jump is taken, otherwise the right one is moved in.
+    // The register is free while the right operand is evaluated, as the
+    // left value is known there.
+    expr_result left = bop.get_left()->accept_with_result(*this);
+    if(alloc.is_pinned(left.reg_num)) {
+        auto r = alloc.alloc("Short circuit result");
+        writer.mov(r, left.reg_num);
+        alloc.dealloc(left.reg_num);
+        left.reg_num = r;
+    }
+    try {
+        expect_types(type_context::get_bool(), left.type_obj, yy::location{});
+        if(bop.get_op() == binop::AND)
+            writer.beq(left.reg_num, 0, end_label);
+        else
+            writer.bne(left.reg_num, 0, end_label);
+        alloc.dealloc(left.reg_num);
+
+        expr_result right = bop.get_right()->accept_with_result(*this);
+        expect_types(type_context::get_bool(), right.type_obj, yy::location{});
+        if(right.reg_num != left.reg_num) {
+            alloc.take(left.reg_num, "Short circuit result");
+            writer.mov(left.reg_num, right.reg_num);
+            alloc.dealloc(right.reg_num);
+        }
+    } catch(unexpected_type_exception& e) {
+        e.loc = bop.get_loc();
+        throw e;
+    }
+
+    writer.label(end_label);
+    this->result = expr_result{ type_context::get_bool(), left.reg_num };
+    debug_out << "# Done short circuit" << "\n";
+}
+
 void code_visitor::visit(const assign_statement& stm) {
     debug_out << "# Enter assing" << "\n";
     /*
@@ -341,12 +567,18 @@ void code_visitor::visit(const assign_statement& stm) {
     a = 42;
     */
 
-    if(stm.get_type() != nullptr) {
-        // push on stack
-        writer.push(0);
-        stack_height++;
+    if(stm.get_type() != nullptr && promotion->place(stm) != local_promotion::placement::STACK) {
+        sym_info sym = sym_info{ stm.get_identifier(), stm.get_type(), sym_info::REG, 0 };
+        sym.reg = local_regs.at(&stm);
+        // Declared variables start as 0
+        if(stm.get_exp() == nullptr)
+            writer.mov(sym.reg, 0);
+        table.add(std::move(sym));
+    } else if(stm.get_type() != nullptr) {
+        // Declared variables start as 0
+        writer.put_arg(0, ++stack_height);
         // add to sym_table
-        sym_info sym = sym_info{ stm.get_identifier(), stm.get_type()->clone(),
+        sym_info sym = sym_info{ stm.get_identifier(), stm.get_type(),
                                  sym_info::STACK, stack_height };
         table.add(std::move(sym));
         debug_out << "# Done assign" << "\n";
@@ -358,7 +590,7 @@ void code_visitor::visit(const assign_statement& stm) {
     if(stm.get_exp() != nullptr) {
         stm.get_exp()->accept(*this);
 
-        func::expect_types(*sym.type_obj, *result.type_obj, stm.get_exp()->get_loc());
+        func::expect_types(sym.type_obj, result.type_obj, stm.get_exp()->get_loc());
 
         store_variable(writer, alloc, result.reg_num, sym);
         alloc.dealloc(result.reg_num);
@@ -388,7 +620,7 @@ void code_visitor::visit(const if_statement& stm) {
     std::string else_end_label = "ELSE_END_" + std::to_string(label_ind++);
 
     stm.get_condition()->accept(*this);
-    expect_types(bool_type{}, *result.type_obj, stm.get_condition()->get_loc());
+    expect_types(type_context::get_bool(), result.type_obj, stm.get_condition()->get_loc());
     
     writer.beq(result.reg_num, 0, then_end_label);
     alloc.dealloc(result.reg_num);
@@ -417,7 +649,7 @@ void code_visitor::visit(const while_statement& stm) {
 
     stm.get_condition()->accept(*this);
 
-    func::expect_types(bool_type{}, *result.type_obj, stm.get_condition()->get_loc());
+    func::expect_types(type_context::get_bool(), result.type_obj, stm.get_condition()->get_loc());
 
     writer.beq(result.reg_num, 0, while_end_label);
     alloc.dealloc(result.reg_num);
@@ -431,14 +663,18 @@ void code_visitor::visit(const while_statement& stm) {
 
 void code_visitor::visit(const subscript_expression& sub) {
     debug_out << "# Enter subscript" << "\n";
-    expr_result ptr = sub.get_pointer()->accept_with_result(*this);
+    held_value held_ptr{ sub.get_pointer()->accept_with_result(*this) };
 
-    if(ptr.type_obj->get_type() != types::STRING)
+    if(held_ptr.res.type_obj->get_type() != types::STRING)
         throw unexpected_type_exception{
             { "expected string as subscript target", sub.get_pointer()->get_loc() }
         };
 
+    make_room({ &held_ptr }, *sub.get_index());
     expr_result idx = sub.get_index()->accept_with_result(*this);
+    if(held_ptr.slot != 0)
+        reload(held_ptr);
+    expr_result ptr = held_ptr.res;
 
     if(idx.type_obj->get_type() != types::INT)
         throw unexpected_type_exception{ { "expected int as subscript index",
@@ -446,35 +682,42 @@ void code_visitor::visit(const subscript_expression& sub) {
 
     auto r = alloc.alloc();
 
-    writer.add(ptr.reg_num, ptr.reg_num, idx.reg_num);
-    writer.lw(r, ptr.reg_num, 0);
+    writer.add(r, ptr.reg_num, idx.reg_num);
+    writer.lw(r, r, 0);
 
     alloc.dealloc(ptr.reg_num);
     alloc.dealloc(idx.reg_num);
     result.reg_num = r;
-    result.type_obj = std::make_unique<int_type>();
+    result.type_obj = type_context::get_int();
     debug_out << "# Done subscript" << "\n";
 };
 
 void code_visitor::visit(const subscript_assign_statement& sub) {
     debug_out << "# Enter subscript assign" << "\n";
 
-    expr_result ptr = sub.get_pointer()->accept_with_result(*this);
+    held_value held_ptr{ sub.get_pointer()->accept_with_result(*this) };
 
-    if(ptr.type_obj->get_type() != types::STRING)
+    if(held_ptr.res.type_obj->get_type() != types::STRING)
         throw unexpected_type_exception{
             { "expected string as subscript target", sub.get_pointer()->get_loc() }
         };
 
+    make_room({ &held_ptr }, *sub.get_index());
     expr_result idx = sub.get_index()->accept_with_result(*this);
+    if(held_ptr.slot != 0)
+        reload(held_ptr);
+    expr_result ptr = held_ptr.res;
 
     if(idx.type_obj->get_type() != types::INT)
         throw unexpected_type_exception{ { "expected int as subscript index",
                                            sub.get_index()->get_loc() } };
 
-    writer.add(ptr.reg_num, ptr.reg_num, idx.reg_num);
+    held_value addr{ { type_context::get_string(), alloc.alloc("Subscript address") } };
+    writer.add(addr.res.reg_num, ptr.reg_num, idx.reg_num);
+    alloc.dealloc(ptr.reg_num);
     alloc.dealloc(idx.reg_num);
 
+    make_room({ &addr }, *sub.get_exp());
     expr_result exp = sub.get_exp()->accept_with_result(*this);
 
     if(exp.type_obj->get_type() != types::INT)
@@ -482,9 +725,11 @@ void code_visitor::visit(const subscript_assign_statement& sub) {
             { "expected int as assignee to string subscript", sub.get_exp()->get_loc() }
         };
 
-    writer.sw(ptr.reg_num, 0, exp.reg_num);
+    if(addr.slot != 0)
+        reload(addr);
+    writer.sw(addr.res.reg_num, 0, exp.reg_num);
 
-    alloc.dealloc(ptr.reg_num);
+    alloc.dealloc(addr.res.reg_num);
     alloc.dealloc(exp.reg_num);
     debug_out << "# Done subscript assign" << "\n";
 };
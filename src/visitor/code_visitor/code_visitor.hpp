@@ -3,7 +3,9 @@
 #include "codegen/location.hh"
 #include "printer.hpp"
 #include "type/type.hpp"
+#include "visitor/code_visitor/evaluation_order.hpp"
 #include "visitor/code_visitor/instruction_writer.hpp"
+#include "visitor/code_visitor/local_promotion.hpp"
 #include "visitor/code_visitor/register_allocator.hpp"
 #include "visitor/sym_table.hpp"
 #include "visitor/visitor.hpp"
@@ -11,51 +13,71 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace func {
 
 struct expr_result {
-    std::unique_ptr<func::type> type_obj;
+    const func::type* type_obj{ nullptr };
     uint8_t reg_num;
 };
 
 struct sym_info {
-    std::string name;
-    std::unique_ptr<func::type> type_obj;
-    enum : char { STACK, ABS } access_type;
+    symbol name;
+    const func::type* type_obj{ nullptr };
+    enum : char { STACK, ABS, REG } access_type;
+    // Slot below BP of a STACK symbol
     uint16_t offset;
+    // Register holding a REG symbol, see local_promotion
+    uint8_t reg{ 0 };
+    // Code label whose address an ABS symbol is, resolved when the code is printed
+    std::string label;
     yy::location declare_loc;
-    bool is_delimeter = false;
 
     public:
-    sym_info(std::string name,
-             const std::unique_ptr<func::type>& type_obj,
+    sym_info(symbol name,
+             const func::type* type_obj,
              decltype(STACK) access_type,
              uint16_t offset,
-             yy::location declare_loc = yy::location{},
-             bool is_delimeter = false)
-    : name{ std::move(name) }, type_obj{ type_obj->clone() },
-      access_type{ access_type }, offset{ offset }, declare_loc{ declare_loc },
-      is_delimeter{ is_delimeter } {}
+             yy::location declare_loc = yy::location{})
+    : name{ name }, type_obj{ type_obj },
+      access_type{ access_type }, offset{ offset }, declare_loc{ declare_loc } {}
+    sym_info(symbol name, const func::type* type_obj, std::string label)
+    : name{ name }, type_obj{ type_obj }, access_type{ ABS }, offset{ 0 },
+      label{ std::move(label) } {}
     sym_info() = default;
-    sym_info(const sym_info& sym)
-    : name{ sym.name }, access_type{ sym.access_type }, offset{ sym.offset },
-      declare_loc{ sym.declare_loc }, is_delimeter{ sym.is_delimeter } {
-        if(sym.type_obj != nullptr)
-            type_obj = sym.type_obj->clone();
-    }
+};
+
+// An operand waiting for the others, in a register or spilled to a stack slot
+struct held_value {
+    expr_result res;
+    // Slot below BP, 0 while the value is in the register
+    uint16_t slot{ 0 };
 };
 
 class code_visitor : public visitor<expr_result> {
     private:
-    func::stream_proxy& debug_out;
+    func::instr::instruction_writer writer;
+    // -d and -a output, kept by the writer next to the instructions
+    func::stream_proxy debug_out;
+    func::stream_proxy alloc_out;
     expr_result result;
     sym_table<sym_info> table;
     reg_allocator alloc;
-    func::instr::instruction_writer writer;
+    // Slots of the frame of the current function below BP
     uint16_t stack_height = 0;
     uint16_t label_ind = 0;
+    // Variables of the current function kept in registers
+    std::unique_ptr<local_promotion> promotion;
+    std::vector<uint8_t> pinned_regs;
+    std::unordered_map<const assign_statement*, uint8_t> local_regs;
+    // Callee-saved registers the function saves, with their slots
+    std::vector<std::pair<uint8_t, uint16_t>> saved_regs;
+    std::unique_ptr<evaluation_order> order;
+    // Spill slots of the current function not holding a value
+    std::vector<uint16_t> free_spill_slots;
 
     public:
     code_visitor(func::printer& printer);
@@ -79,9 +101,23 @@ class code_visitor : public visitor<expr_result> {
 
     expr_result&& extract_result() override { return std::move(result); }
 
+    // Run once the program is visited
+    void optimize_code() { writer.peephole(); }
+    void emit_code() { writer.print(); }
+    // Emulator instructions written so far
+    uint16_t instruction_count() const { return writer.get_next_addr(); }
+
     private:
     void declare_write_func();
     void declare_read_func();
+    uint8_t pin_variable(const symbol& name, local_promotion::placement place);
+    // Spills the HELD values until there are registers to evaluate NEXT
+    void make_room(const std::vector<held_value*>& held, const ast_node& next);
+    void spill(held_value& v);
+    void reload(held_value& v);
+    void reload_into(held_value& v, uint8_t reg);
+    // && and || skip their right operand once the left one decides.
+    void short_circuit(const binop_expression&);
 };
 
 } // namespace func
@@ -0,0 +1,188 @@
+#include "visitor/code_visitor/evaluation_order.hpp"
+#include "node/expression.hpp"
+#include "node/function.hpp"
+#include "node/statement.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <variant>
+
+namespace func {
+
+evaluation_order::evaluation_order(const function& f) {
+    if(f.get_block() != nullptr)
+        f.get_block()->accept(*this);
+}
+
+uint32_t evaluation_order::registers_needed(const ast_node& exp) const {
+    return info.at(&exp).registers;
+}
+
+bool evaluation_order::right_first(const binop_expression& bop) const {
+    return right_first_binops.count(&bop) != 0;
+}
+
+const std::vector<size_t>& evaluation_order::operand_order(const function_call& fc) const {
+    return call_orders.at(&fc);
+}
+
+evaluation_order::expr_info evaluation_order::analyze(const ast_node& exp) {
+    exp.accept(*this);
+    info[&exp] = last;
+    return last;
+}
+
+void evaluation_order::statement_needs(uint32_t registers) {
+    max_registers = std::max(max_registers, registers);
+}
+
+// Swapping A and B doesn't reorder a call with another call or with a
+// read of memory the call may write
+bool evaluation_order::can_swap(const expr_info& a, const expr_info& b) {
+    if(a.calls && (b.calls || b.reads_memory))
+        return false;
+    return !(b.calls && a.reads_memory);
+}
+
+// The register counts follow the allocations of code_visitor
+
+void evaluation_order::visit(const binop_expression& bop) {
+    auto left = analyze(*bop.get_left());
+    auto right = analyze(*bop.get_right());
+    expr_info res{ 0, left.calls || right.calls, left.reads_memory || right.reads_memory };
+
+    if(bop.get_op() == binop::AND || bop.get_op() == binop::OR) {
+        // The right operand is skipped at times, so it always goes second
+        res.registers = std::max({ left.registers, right.registers + 1, 2u });
+        last = res;
+        return;
+    }
+
+    bool swap = right.registers > left.registers && can_swap(left, right);
+    if(swap)
+        right_first_binops.insert(&bop);
+    const auto& first = swap ? right : left;
+    const auto& second = swap ? left : right;
+    // Both operands are held while the result is computed, > takes a scratch register
+    uint32_t op = bop.get_op() == binop::GRTR ? 4 : 3;
+    res.registers = std::max({ first.registers, second.registers + 1, op });
+    last = res;
+}
+
+void evaluation_order::visit(const unarop_expression& unop) {
+    auto exp = analyze(*unop.get_exp());
+    exp.registers = std::max(exp.registers, 2u);
+    last = exp;
+}
+
+void evaluation_order::visit(const literal_expression& lit) {
+    auto val = lit.get_val();
+    last = expr_info{ std::holds_alternative<std::string>(val) ? 2u : 1u };
+}
+
+void evaluation_order::visit(const identifier_expression&) { last = expr_info{ 1 }; }
+
+void evaluation_order::visit(const function_call& fc) {
+    const auto& args = fc.get_arg_list();
+    std::vector<expr_info> operands;
+    for(const auto& arg : args)
+        operands.push_back(analyze(*arg));
+    operands.push_back(analyze(*fc.get_func()));
+
+    // Operands that call or read memory keep their order, the function
+    // first, and the others are merged in by their register count
+    std::deque<size_t> fixed;
+    std::vector<size_t> movable;
+    for(size_t k = 0; k < operands.size(); k++) {
+        size_t idx = (k + args.size()) % operands.size();
+        if(operands[idx].calls || operands[idx].reads_memory)
+            fixed.push_back(idx);
+        else
+            movable.push_back(idx);
+    }
+    std::stable_sort(movable.begin(), movable.end(), [&operands](size_t a, size_t b) {
+        return operands[a].registers > operands[b].registers;
+    });
+
+    std::vector<size_t> order;
+    auto movable_iter = movable.begin();
+    while(!fixed.empty() || movable_iter != movable.end()) {
+        bool take_fixed = movable_iter == movable.end() ||
+                          (!fixed.empty() &&
+                           operands[fixed.front()].registers >= operands[*movable_iter].registers);
+        if(take_fixed) {
+            order.push_back(fixed.front());
+            fixed.pop_front();
+        } else {
+            order.push_back(*movable_iter++);
+        }
+    }
+
+    // The evaluated operands are held until the call
+    expr_info res{ static_cast<uint32_t>(operands.size()), true, false };
+    for(size_t i = 0; i < order.size(); i++) {
+        const auto& op = operands[order[i]];
+        res.registers = std::max(res.registers, static_cast<uint32_t>(i) + op.registers);
+        res.reads_memory = res.reads_memory || op.reads_memory;
+    }
+    call_orders[&fc] = std::move(order);
+    last = res;
+}
+
+void evaluation_order::visit(const subscript_expression& sub) {
+    auto ptr = analyze(*sub.get_pointer());
+    auto idx = analyze(*sub.get_index());
+    last = expr_info{ std::max({ ptr.registers, idx.registers + 1, 3u }), ptr.calls || idx.calls,
+                      true };
+}
+
+void evaluation_order::visit(const subscript_assign_statement& sub) {
+    auto ptr = analyze(*sub.get_pointer());
+    auto idx = analyze(*sub.get_index());
+    auto exp = analyze(*sub.get_exp());
+    statement_needs(std::max({ ptr.registers, idx.registers + 1, 3u, exp.registers + 1 }));
+}
+
+void evaluation_order::visit(const program&) {}
+
+void evaluation_order::visit(const block_statement& b) {
+    // A call statement is an expression, the other statements count themselves
+    for(const auto& st : b.get_statements()) {
+        if(dynamic_cast<const function_call*>(st.get()) != nullptr)
+            statement_needs(analyze(*st).registers);
+        else
+            st->accept(*this);
+    }
+}
+
+void evaluation_order::visit(const return_statement& ret) {
+    // ret pops the return address into a register
+    uint32_t needed = 1;
+    if(ret.get_exp() != nullptr)
+        needed = std::max(needed, analyze(*ret.get_exp()).registers);
+    statement_needs(needed);
+}
+
+void evaluation_order::visit(const assign_statement& stm) {
+    if(stm.get_exp() != nullptr)
+        statement_needs(analyze(*stm.get_exp()).registers);
+}
+
+void evaluation_order::visit(const if_statement& stm) {
+    statement_needs(analyze(*stm.get_condition()).registers);
+    stm.get_then_block()->accept(*this);
+    if(stm.get_else_block() != nullptr)
+        stm.get_else_block()->accept(*this);
+}
+
+void evaluation_order::visit(const while_statement& stm) {
+    statement_needs(analyze(*stm.get_condition()).registers);
+    stm.get_block()->accept(*this);
+}
+
+void evaluation_order::visit(const declaration&) {}
+
+void evaluation_order::visit(const function&) {}
+
+} // namespace func
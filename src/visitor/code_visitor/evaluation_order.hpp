@@ -0,0 +1,67 @@
+#pragma once
+
+#include "node/expression.hpp"
+#include "node/function.hpp"
+#include "visitor/visitor.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace func {
+
+// Sethi-Ullman numbering of the expressions of a function: the registers
+// code_visitor needs to evaluate each one without spilling, counting every
+// variable read as a register. Operands are evaluated the one needing more
+// registers first, unless that could change what the program does: calls
+// keep their order and don't move across reads of strings.
+class evaluation_order : public visitor<void> {
+    struct expr_info {
+        uint32_t registers{ 0 };
+        bool calls{ false };
+        bool reads_memory{ false };
+    };
+
+    std::unordered_map<const ast_node*, expr_info> info;
+    std::unordered_set<const binop_expression*> right_first_binops;
+    std::unordered_map<const function_call*, std::vector<size_t>> call_orders;
+    // The last visited expression
+    expr_info last;
+    uint32_t max_registers = 0;
+
+    public:
+    explicit evaluation_order(const function& f);
+
+    uint32_t registers_needed(const ast_node& exp) const;
+    // Most registers an expression of the function needs
+    uint32_t max_registers_needed() const { return max_registers; }
+    bool right_first(const binop_expression& bop) const;
+    // Order to evaluate the arguments in, the function itself is get_arg_list().size()
+    const std::vector<size_t>& operand_order(const function_call& fc) const;
+
+    void visit(const binop_expression&) override;
+    void visit(const unarop_expression&) override;
+    void visit(const literal_expression&) override;
+    void visit(const identifier_expression&) override;
+    void visit(const function_call&) override;
+    void visit(const subscript_expression&) override;
+
+    void visit(const subscript_assign_statement&) override;
+    void visit(const program&) override;
+    void visit(const block_statement&) override;
+    void visit(const return_statement&) override;
+    void visit(const assign_statement&) override;
+    void visit(const if_statement&) override;
+    void visit(const while_statement&) override;
+    void visit(const declaration&) override;
+    void visit(const function&) override;
+
+    private:
+    expr_info analyze(const ast_node& exp);
+    void statement_needs(uint32_t registers);
+    static bool can_swap(const expr_info& a, const expr_info& b);
+};
+
+} // namespace func
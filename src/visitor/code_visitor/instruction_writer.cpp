@@ -0,0 +1,367 @@
+#include "visitor/code_visitor/instruction_writer.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace func::instr {
+
+namespace {
+
+const char* mnemonic(opcode op) {
+    switch(op) {
+    case opcode::LUI: return "lui";
+    case opcode::ADDI: return "addi";
+    case opcode::LI: return "li";
+    case opcode::XORI: return "xori";
+    case opcode::ADD: return "add";
+    case opcode::SUB: return "sub";
+    case opcode::XOR: return "xor";
+    case opcode::SRL: return "srl";
+    case opcode::SRA: return "sra";
+    case opcode::OR: return "or";
+    case opcode::AND: return "and";
+    case opcode::MUL: return "mul";
+    case opcode::DIV: return "div";
+    case opcode::REM: return "rem";
+    case opcode::SLL: return "sll";
+    case opcode::SLT: return "slt";
+    case opcode::SEQ: return "seq";
+    case opcode::SNE: return "sne";
+    case opcode::SGE: return "sge";
+    case opcode::LW: return "lw";
+    case opcode::SW: return "sw";
+    case opcode::JALR: return "jalr";
+    case opcode::JAL: return "jal";
+    case opcode::BEQ: return "beq";
+    case opcode::BNE: return "bne";
+    case opcode::BLT: return "blt";
+    case opcode::BGE: return "bge";
+    case opcode::EBREAK: return "ebreak";
+    case opcode::EREAD: return "eread";
+    case opcode::EWRITE: return "ewrite";
+    case opcode::LABEL: break;
+    }
+    return "";
+}
+
+// The branch taken when OP is not
+opcode inverse_branch(opcode op) {
+    switch(op) {
+    case opcode::BEQ: return opcode::BNE;
+    case opcode::BNE: return opcode::BEQ;
+    case opcode::BLT: return opcode::BGE;
+    default: return opcode::BLT;
+    }
+}
+
+bool is_branch(opcode op) {
+    return op == opcode::BEQ || op == opcode::BNE || op == opcode::BLT || op == opcode::BGE;
+}
+
+// Words the instruction takes in the emulator memory
+uint16_t size_of(const instruction& inst) {
+    switch(inst.op) {
+    case opcode::LABEL: return 0;
+    // Code addresses are below 2^20
+    case opcode::LI:
+        if(!inst.label.empty())
+            return inst.named ? 2 : 1;
+        return inst.imm >= (1 << 20) ? 2 : 1;
+    case opcode::BEQ:
+    case opcode::BNE:
+    case opcode::BLT:
+    case opcode::BGE: return inst.label.empty() ? 1 : 2;
+    default: return 1;
+    }
+}
+
+std::string reg(uint8_t n) { return "x" + std::to_string(n); }
+
+// Control may reach the next instruction from elsewhere or not at all
+bool ends_block(opcode op) {
+    return op == opcode::LABEL || op == opcode::JAL || op == opcode::JALR ||
+           op == opcode::EBREAK || is_branch(op);
+}
+
+// Register the instruction writes, 0 if none
+uint8_t written_reg(const instruction& inst) {
+    switch(inst.op) {
+    case opcode::SW:
+    case opcode::BEQ:
+    case opcode::BNE:
+    case opcode::BLT:
+    case opcode::BGE:
+    case opcode::EBREAK:
+    case opcode::EWRITE:
+    case opcode::LABEL: return 0;
+    default: return inst.d;
+    }
+}
+
+bool is_sp_step(const instruction& inst) {
+    return inst.op == opcode::ADDI && inst.d == SP && inst.s1 == SP;
+}
+
+instruction make_mov(uint8_t d, uint8_t s) { return instruction{ opcode::ADDI, d, s, 0, 0 }; }
+
+// addi x, x, 0
+bool remove_self_moves(std::vector<instruction>& code, std::vector<bool>& dead) {
+    bool changed = false;
+    for(size_t i = 0; i < code.size(); i++) {
+        const auto& inst = code[i];
+        if(inst.op == opcode::ADDI && inst.d == inst.s1 && inst.imm == 0) {
+            dead[i] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// push a; pop b -> addi b, a, 0
+bool merge_push_pop(std::vector<instruction>& code, std::vector<bool>& dead) {
+    bool changed = false;
+    for(size_t i = 0; i + 3 < code.size(); i++) {
+        const auto& store = code[i + 1];
+        const auto& load = code[i + 2];
+        if(is_sp_step(code[i]) && code[i].imm == -1 && store.op == opcode::SW &&
+           store.s1 == SP && store.imm == 0 && store.s2 != SP && load.op == opcode::LW &&
+           load.s1 == SP && load.imm == 0 && load.d != SP && is_sp_step(code[i + 3]) &&
+           code[i + 3].imm == 1) {
+            code[i] = make_mov(load.d, store.s2);
+            dead[i + 1] = dead[i + 2] = dead[i + 3] = true;
+            changed = true;
+            i += 3;
+        }
+    }
+    return changed;
+}
+
+// Moves SP steps down past the accesses through SP and merges them, so a run
+// of pushes or pops moves SP once:
+// addi SP, SP, -1; sw SP, 0, a; addi SP, SP, -1; sw SP, 0, b
+// -> sw SP, -1, a; sw SP, -2, b; addi SP, SP, -2
+bool merge_sp_steps(std::vector<instruction>& code, std::vector<bool>& dead) {
+    bool changed = false;
+    for(size_t i = 0; i + 1 < code.size(); i++) {
+        if(!is_sp_step(code[i]))
+            continue;
+        auto& next = code[i + 1];
+        if(is_sp_step(next)) {
+            next.imm += code[i].imm;
+            dead[i] = true;
+            changed = true;
+        } else if((next.op == opcode::LW && next.s1 == SP && next.d != SP) ||
+                  (next.op == opcode::SW && next.s1 == SP && next.s2 != SP)) {
+            next.imm += code[i].imm;
+            std::swap(code[i], code[i + 1]);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+// A load of a slot whose value a register already holds, because it was
+// stored or loaded before in the same block, becomes a move or goes away
+bool forward_loads(std::vector<instruction>& code, std::vector<bool>& dead) {
+    struct known_slot {
+        uint8_t base;
+        int32_t offset;
+        uint8_t reg;
+    };
+    std::vector<known_slot> known;
+    auto forget = [&known](uint8_t r) {
+        known.erase(std::remove_if(known.begin(), known.end(),
+                                   [r](const known_slot& k) { return k.base == r || k.reg == r; }),
+                    known.end());
+    };
+
+    bool changed = false;
+    for(size_t i = 0; i < code.size(); i++) {
+        auto& inst = code[i];
+        if(ends_block(inst.op)) {
+            known.clear();
+            continue;
+        }
+        if(inst.op == opcode::SW) {
+            // Any slot may be the one written
+            known.clear();
+            known.push_back({ inst.s1, inst.imm, inst.s2 });
+            continue;
+        }
+        if(inst.op == opcode::LW) {
+            uint8_t base = inst.s1;
+            int32_t offset = inst.imm;
+            auto iter = std::find_if(known.begin(), known.end(), [&](const known_slot& k) {
+                return k.base == base && k.offset == offset;
+            });
+            if(iter != known.end()) {
+                if(iter->reg == inst.d)
+                    dead[i] = true;
+                else
+                    inst = make_mov(inst.d, iter->reg);
+                changed = true;
+                if(dead[i])
+                    continue;
+            }
+            forget(inst.d);
+            if(inst.d != base)
+                known.push_back({ base, offset, inst.d });
+            continue;
+        }
+        if(uint8_t d = written_reg(inst); d != 0)
+            forget(d);
+    }
+    return changed;
+}
+
+} // namespace
+
+void instruction_writer::emit(instruction inst) {
+    inst.comment = comments.str();
+    comments.str("");
+    code.push_back(std::move(inst));
+}
+
+void instruction_writer::erase(const std::vector<bool>& dead) {
+    std::vector<instruction> kept;
+    kept.reserve(code.size());
+    std::string comment;
+    for(size_t i = 0; i < code.size(); i++) {
+        comment += code[i].comment;
+        if(dead[i])
+            continue;
+        code[i].comment = std::move(comment);
+        comment.clear();
+        kept.push_back(std::move(code[i]));
+    }
+    code = std::move(kept);
+    // Printed after the last instruction
+    comments.str(comment + comments.str());
+}
+
+bool instruction_writer::retarget(uint8_t from, uint8_t to) {
+    if(code.empty() || written_reg(code.back()) != from)
+        return false;
+    code.back().d = to;
+    return true;
+}
+
+void instruction_writer::parallel_move(std::vector<std::pair<uint8_t, uint8_t>> moves) {
+    moves.erase(std::remove_if(moves.begin(), moves.end(),
+                               [](const auto& m) { return m.first == m.second; }),
+                moves.end());
+    while(!moves.empty()) {
+        // A move whose dest no other move still reads
+        auto ready = std::find_if(moves.begin(), moves.end(), [&moves](const auto& m) {
+            return std::none_of(moves.begin(), moves.end(),
+                                [&m](const auto& other) { return other.second == m.first; });
+        });
+        if(ready != moves.end()) {
+            mov(ready->first, ready->second);
+            moves.erase(ready);
+            continue;
+        }
+        // Only cycles are left: one of the sources goes to RR
+        uint8_t src = moves.front().second;
+        mov(RR, src);
+        for(auto& m : moves) {
+            if(m.second == src)
+                m.second = RR;
+        }
+    }
+}
+
+uint16_t instruction_writer::get_next_addr() const {
+    uint16_t addr = 0;
+    for(const auto& inst : code)
+        addr += size_of(inst);
+    return addr;
+}
+
+void instruction_writer::peephole() {
+    using pass = bool (*)(std::vector<instruction>&, std::vector<bool>&);
+    // Push and pop pairs go first, before merge_sp_steps splits them
+    const pass passes[] = { remove_self_moves, merge_push_pop, merge_sp_steps, forward_loads };
+
+    // A rewrite may expose another one, e.g. a forwarded load becomes addi x, x, 0
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(pass p : passes) {
+            std::vector<bool> dead(code.size(), false);
+            if(p(code, dead)) {
+                changed = true;
+                erase(dead);
+            }
+        }
+    }
+}
+
+void instruction_writer::print() {
+    std::unordered_map<std::string, uint16_t> labels;
+    uint16_t addr = 0;
+    for(const auto& inst : code) {
+        if(inst.op == opcode::LABEL)
+            labels[inst.label] = addr;
+        addr += size_of(inst);
+    }
+
+    for(const auto& inst : code) {
+        const char* name = mnemonic(inst.op);
+        out << inst.comment;
+        switch(inst.op) {
+        case opcode::LABEL: out << inst.label << ": " << "\n"; break;
+        case opcode::LUI: out << name << " " << reg(inst.d) << ", " << inst.imm << "\n"; break;
+        case opcode::LI:
+            out << name << " " << reg(inst.d) << ", ";
+            if(inst.label.empty())
+                out << inst.imm;
+            else if(inst.named)
+                out << inst.label;
+            else
+                out << labels.at(inst.label);
+            out << "\n";
+            break;
+        case opcode::ADDI:
+        case opcode::XORI:
+        case opcode::LW:
+        case opcode::JALR:
+            out << name << " " << reg(inst.d) << ", " << reg(inst.s1) << ", " << inst.imm << "\n";
+            break;
+        case opcode::SW:
+            out << name << " " << reg(inst.s1) << ", " << inst.imm << ", " << reg(inst.s2) << "\n";
+            break;
+        case opcode::JAL:
+            out << name << " " << reg(inst.d) << ", ";
+            if(inst.label.empty())
+                out << inst.imm;
+            else
+                out << inst.label;
+            out << "\n";
+            break;
+        case opcode::BEQ:
+        case opcode::BNE:
+        case opcode::BLT:
+        case opcode::BGE:
+            if(inst.label.empty()) {
+                out << name << " " << reg(inst.s1) << ", " << reg(inst.s2) << ", " << inst.imm << "\n";
+                break;
+            }
+            // Skip the jump unless the branch is taken
+            out << mnemonic(inverse_branch(inst.op)) << " " << reg(inst.s1) << ", "
+                << reg(inst.s2) << ", 1\n";
+            out << "jal x0, " << inst.label << "\n";
+            break;
+        case opcode::EBREAK: out << name << "\n"; break;
+        case opcode::EREAD: out << name << " " << reg(inst.d) << "\n"; break;
+        case opcode::EWRITE: out << name << " " << reg(inst.s1) << "\n"; break;
+        default:
+            out << name << " " << reg(inst.d) << ", " << reg(inst.s1) << ", " << reg(inst.s2) << "\n";
+            break;
+        }
+    }
+    out << comments.str();
+    comments.str("");
+}
+
+} // namespace func::instr
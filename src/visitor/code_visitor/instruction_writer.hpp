@@ -3,8 +3,12 @@
 #include "printer.hpp"
 #include "visitor/code_visitor/register_allocator.hpp"
 
+#include <cstddef>
 #include <cstdint>
+#include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace func::instr {
 
@@ -12,176 +16,154 @@ const uint8_t SP = 31;
 const uint8_t BP = 30;
 const uint8_t RR = 29; // Return register
 
+enum class opcode : char {
+    LUI,
+    ADDI,
+    LI,
+    XORI,
+    ADD,
+    SUB,
+    XOR,
+    SRL,
+    SRA,
+    OR,
+    AND,
+    MUL,
+    DIV,
+    REM,
+    SLL,
+    SLT,
+    SEQ,
+    SNE,
+    SGE,
+    LW,
+    SW,
+    JALR,
+    JAL,
+    BEQ,
+    BNE,
+    BLT,
+    BGE,
+    EBREAK,
+    EREAD,
+    EWRITE,
+    // Not an instruction: a printed label
+    LABEL
+};
+
+// One line of the program. Addresses of labels are only known once the
+// whole program is built, so LABEL refers to a label where the emulator
+// takes a number:
+// - li with a label loads its address, li_label keeps the name for the assembler
+// - a branch with a label jumps to it through jal, as the branch offset is short
+// - jal with a label is a jump the assembler resolves
+struct instruction {
+    opcode op;
+    uint8_t d;
+    uint8_t s1;
+    uint8_t s2;
+    int32_t imm;
+    std::string label;
+    // li keeps the label name as is
+    bool named;
+    // -d and -a output printed before the instruction
+    std::string comment;
+
+    instruction(opcode op,
+                uint8_t d = 0,
+                uint8_t s1 = 0,
+                uint8_t s2 = 0,
+                int32_t imm = 0,
+                std::string label = "",
+                bool named = false)
+    : op{ op }, d{ d }, s1{ s1 }, s2{ s2 }, imm{ imm }, label{ std::move(label) },
+      named{ named } {}
+};
+
+// Builds the program in memory, so it can be improved before it's printed
 class instruction_writer {
-    uint16_t next_addr = 0;
+    std::vector<instruction> code;
+    // -d and -a output since the last instruction
+    std::ostringstream comments;
     func::stream_proxy& out;
 
     public:
     instruction_writer(func::stream_proxy& out) : out{ out } {}
-    uint16_t get_next_addr() const { return next_addr; }
+    // Size of the program in emulator words
+    uint16_t get_next_addr() const;
+    // Where debug output goes to stay next to the instructions it's about
+    std::ostream& comment_stream() { return comments; }
 
-    void lui(uint8_t d, int32_t imm) {
-        out << "lui " << reg(d) << ", " << imm << "\n";
-        next_addr++;
-    }
+    // Local rewrites of the program within basic blocks, see instruction_writer.cpp
+    void peephole();
+    // Resolves the labels and writes the program to the output
+    void print();
+    // Makes the last instruction write TO instead of FROM, if it writes FROM
+    bool retarget(uint8_t from, uint8_t to);
 
-    void addi(uint8_t d, uint8_t s, int32_t imm) {
-        out << "addi " << reg(d) << ", " << reg(s) << ", " << imm << "\n";
-        next_addr++;
-    }
+    void lui(uint8_t d, int32_t imm) { emit({ opcode::LUI, d, 0, 0, imm }); }
 
-    void li(uint8_t d, int32_t imm) {
-        out << "li " << reg(d) << ", " << imm << "\n";
-        next_addr += imm >= (1 << 20) ? 2 : 1;
-    }
+    void addi(uint8_t d, uint8_t s, int32_t imm) { emit({ opcode::ADDI, d, s, 0, imm }); }
+
+    void li(uint8_t d, int32_t imm) { emit({ opcode::LI, d, 0, 0, imm }); }
 
     void li_label(uint8_t d, const std::string& label) {
-        out << "li " << reg(d) << ", " << label << "\n";
-        next_addr += 2;
+        emit({ opcode::LI, d, 0, 0, 0, label, true });
     }
 
-    void xori(uint8_t d, uint8_t s, int32_t imm) {
-        out << "xori " << reg(d) << ", " << reg(s) << ", " << imm << "\n";
-        next_addr++;
-    }
+    // Address of LABEL as a number, e.g. of a function
+    void la(uint8_t d, const std::string& label) { emit({ opcode::LI, d, 0, 0, 0, label }); }
 
-    void add(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "add " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void xori(uint8_t d, uint8_t s, int32_t imm) { emit({ opcode::XORI, d, s, 0, imm }); }
 
-    void sub(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "sub " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void add(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::ADD, d, s1, s2 }); }
 
-    void xor_op(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "xor " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void sub(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SUB, d, s1, s2 }); }
 
-    void srl(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "srl " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void xor_op(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::XOR, d, s1, s2 }); }
 
-    void sra(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "sra " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void srl(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SRL, d, s1, s2 }); }
 
-    void or_op(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "or " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void sra(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SRA, d, s1, s2 }); }
 
-    void and_op(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "and " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void or_op(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::OR, d, s1, s2 }); }
 
-    void mul(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "mul " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void and_op(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::AND, d, s1, s2 }); }
 
-    void div(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "div " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void mul(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::MUL, d, s1, s2 }); }
 
-    void rem(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "rem " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void div(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::DIV, d, s1, s2 }); }
 
-    void sll(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "sll " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
-    void slt(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "slt " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void rem(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::REM, d, s1, s2 }); }
 
-    void seq(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "seq " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void sll(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SLL, d, s1, s2 }); }
 
-    void sne(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "sne " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void slt(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SLT, d, s1, s2 }); }
 
-    void sge(uint8_t d, uint8_t s1, uint8_t s2) {
-        out << "sge " << reg(d) << ", " << reg(s1) << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void seq(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SEQ, d, s1, s2 }); }
+
+    void sne(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SNE, d, s1, s2 }); }
+
+    void sge(uint8_t d, uint8_t s1, uint8_t s2) { emit({ opcode::SGE, d, s1, s2 }); }
 
     // Memory Access
-    void lw(uint8_t d, uint8_t s, int32_t imm) {
-        out << "lw " << reg(d) << ", " << reg(s) << ", " << imm << "\n";
-        next_addr++;
-    }
+    void lw(uint8_t d, uint8_t s, int32_t imm) { emit({ opcode::LW, d, s, 0, imm }); }
 
-    void sw(uint8_t s1, int32_t imm, uint8_t s2) {
-        out << "sw " << reg(s1) << ", " << imm << ", " << reg(s2) << "\n";
-        next_addr++;
-    }
+    void sw(uint8_t s1, int32_t imm, uint8_t s2) { emit({ opcode::SW, 0, s1, s2, imm }); }
 
     // Jump and Link
-    void jalr(uint8_t d, uint8_t s, int32_t imm) {
-        out << "jalr " << reg(d) << ", " << reg(s) << ", " << imm << "\n";
-        next_addr++;
-    }
-
-    void jal(uint8_t d, int32_t imm) {
-        out << "jal " << reg(d) << ", " << imm << "\n";
-        next_addr++;
-    }
+    void jalr(uint8_t d, uint8_t s, int32_t imm) { emit({ opcode::JALR, d, s, 0, imm }); }
 
     void jal_label(uint8_t d, const std::string& label) {
-        out << "jal " << reg(d) << ", " << label << "\n";
-        next_addr++;
-    }
-
-    // Branches
-    void beq(uint8_t s1, uint8_t s2, int32_t imm) {
-        out << "beq " << reg(s1) << ", " << reg(s2) << ", " << imm << "\n";
-        next_addr++;
-    }
-
-    void bne(uint8_t s1, uint8_t s2, int32_t imm) {
-        out << "bne " << reg(s1) << ", " << reg(s2) << ", " << imm << "\n";
-        next_addr++;
-    }
-
-    void blt(uint8_t s1, uint8_t s2, int32_t imm) {
-        out << "blt " << reg(s1) << ", " << reg(s2) << ", " << imm << "\n";
-        next_addr++;
-    }
-
-    void bge(uint8_t s1, uint8_t s2, int32_t imm) {
-        out << "bge " << reg(s1) << ", " << reg(s2) << ", " << imm << "\n";
-        next_addr++;
+        emit({ opcode::JAL, d, 0, 0, 0, label });
     }
 
     // System Instructions
-    void ebreak() {
-        out << "ebreak\n";
-        next_addr++;
-    }
+    void ebreak() { emit({ opcode::EBREAK }); }
 
-    void eread(uint8_t d) {
-        out << "eread " << reg(d) << "\n";
-        next_addr++;
-    }
+    void eread(uint8_t d) { emit({ opcode::EREAD, d }); }
 
-    void ewrite(uint8_t s) {
-        out << "ewrite " << reg(s) << "\n";
-        next_addr++;
-    }
+    void ewrite(uint8_t s) { emit({ opcode::EWRITE, 0, s }); }
 
     // Stack pseudo-instructions
 
@@ -211,34 +193,44 @@ class instruction_writer {
     }
 
     // Arg num starts from 1
-    void get_arg(uint8_t dest, uint8_t offset) { lw(dest, BP, -offset); }
+    void get_arg(uint8_t dest, uint16_t offset) { lw(dest, BP, -offset); }
 
-    void put_arg(uint8_t source, uint8_t offset) { sw(BP, -offset, source); }
+    void put_arg(uint8_t source, uint16_t offset) { sw(BP, -offset, source); }
 
-    void label(const std::string& label) { out << label << ": " << "\n"; }
+    void label(const std::string& label) { emit({ opcode::LABEL, 0, 0, 0, 0, label }); }
 
     void mov(uint8_t dest, uint8_t src) { addi(dest, src, 0); }
 
-    void call_start(reg_allocator& alloc, uint8_t args_count) {
-        auto r = alloc.alloc("Call_Start push pc & puch bp");
-        // Push pc
-        jal(r, 0);
-        addi(r, r, 7 + (args_count * 2)); // push of arg is 2 instr
-        push(r);
+    // Moves of (dest, src) done as if at once, the dests all different.
+    // RR breaks the cycles, so it can't be one of them.
+    void parallel_move(std::vector<std::pair<uint8_t, uint8_t>> moves);
 
-        // Push bp (x30)
-        push(BP);
+    // Calls link the return address in RR, the function saves it in its
+    // frame with enter()
+    void call(const std::string& label) { jal_label(RR, label); }
+
+    void call_indirect(uint8_t addr_reg) { jalr(RR, addr_reg, 0); }
 
-        // BP <- SP
+    // Slot OFFSET of the frame of the function about to be called, below
+    // the return address and BP enter() puts at SP
+    void put_callee_arg(uint8_t source, uint16_t offset) { sw(SP, -(offset + 2), source); }
+
+    void enter() {
+        // Push the return address and BP, BP <- SP
+        push(RR);
+        push(BP);
         mov(BP, SP);
-        alloc.dealloc(r);
     }
 
-    void call_end(uint8_t addr_reg) {
-        // Jump
-        jalr(0, addr_reg, 0);
+    // Moves SP below the frame of the function, returns the step so
+    // set_frame_size can patch it once the function is built
+    size_t frame_step() {
+        addi(SP, SP, 0);
+        return code.size() - 1;
     }
 
+    void set_frame_size(size_t step, uint16_t slots) { code[step].imm = -slots; }
+
     void ret(reg_allocator& alloc) {
         // SP <- BP
         addi(SP, BP, 0);
@@ -254,44 +246,44 @@ class instruction_writer {
 
     // Conditional branches to LABEL
     void beq(uint8_t s1, uint8_t s2, const std::string& label) {
-        bne(s1, s2, 1);
-        jal_label(0, label);
+        emit({ opcode::BEQ, 0, s1, s2, 0, label });
     }
 
     void bne(uint8_t s1, uint8_t s2, const std::string& label) {
-        beq(s1, s2, 1);
-        jal_label(0, label);
+        emit({ opcode::BNE, 0, s1, s2, 0, label });
     }
 
     void blt(uint8_t s1, uint8_t s2, const std::string& label) {
-        bge(s1, s2, 1);
-        jal_label(0, label);
+        emit({ opcode::BLT, 0, s1, s2, 0, label });
     }
 
     void bge(uint8_t s1, uint8_t s2, const std::string& label) {
-        blt(s1, s2, 1);
-        jal_label(0, label);
+        emit({ opcode::BGE, 0, s1, s2, 0, label });
     }
 
     // Built in funcs
 
-    void write_func(reg_allocator& alloc) {
+    // They need no frame and return straight through the link
+
+    void write_func() {
         label("WRITE");
-        auto r = alloc.alloc("Get WRITE arg from stack");
-        get_arg(r, 1);
-        ewrite(r);
-        alloc.dealloc(r);
-        ret(alloc);
+        ewrite(reg_allocator::arg_register(0));
+        jalr(0, RR, 0);
     }
 
-    void read_func(reg_allocator& alloc) {
+    void read_func() {
         label("READ");
+        // RR takes the result
+        auto link = reg_allocator::arg_register(0);
+        mov(link, RR);
         eread(RR);
-        ret(alloc);
+        jalr(0, link, 0);
     }
 
     private:
-    std::string reg(uint8_t n) { return "x" + std::to_string(n); }
+    void emit(instruction inst);
+    // Drops the DEAD instructions, their comments go to the next ones
+    void erase(const std::vector<bool>& dead);
 };
 
 } // namespace func::instr
@@ -0,0 +1,180 @@
+#include "visitor/code_visitor/local_promotion.hpp"
+#include "node/expression.hpp"
+#include "node/function.hpp"
+#include "node/statement.hpp"
+
+#include <algorithm>
+
+namespace func {
+
+namespace {
+// Reads and writes a variable needs to take a callee-saved register, which
+// costs a store and a load on every call of the function
+const uint64_t callee_saved_weight = 3;
+} // namespace
+
+local_promotion::local_promotion(const function& f,
+                                 const evaluation_order& order,
+                                 uint8_t caller_saved,
+                                 uint8_t callee_saved)
+: order{ order }, param_places(f.get_params().size(), placement::STACK) {
+    block_starts.push_back(0);
+    for(size_t i = 0; i < f.get_params().size(); i++)
+        declare(f.get_params()[i].get_identifier(), nullptr, i);
+    if(f.get_block() != nullptr)
+        f.get_block()->accept(*this);
+
+    std::vector<size_t> candidates;
+    for(size_t i = 0; i < vars.size(); i++) {
+        if(vars[i].read && !vars[i].read_uninitialized)
+            candidates.push_back(i);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [this](size_t a, size_t b) { return vars[a].weight > vars[b].weight; });
+
+    for(size_t i : candidates) {
+        const auto& v = vars[i];
+        bool across_call = std::any_of(calls.begin(), calls.end(), [&v](uint32_t call) {
+            return v.start < call && call < v.end;
+        });
+        auto place = placement::STACK;
+        if(!across_call && caller_saved > 0) {
+            place = placement::CALLER_SAVED;
+            caller_saved--;
+        } else if(v.weight >= callee_saved_weight && callee_saved > 0) {
+            place = placement::CALLEE_SAVED;
+            callee_saved--;
+        } else {
+            continue;
+        }
+        if(v.decl == nullptr)
+            param_places[v.param] = place;
+        else
+            local_places.emplace_back(v.decl, place);
+    }
+}
+
+local_promotion::placement local_promotion::place(const assign_statement& decl) const {
+    auto iter = std::find_if(local_places.begin(), local_places.end(),
+                             [&decl](const auto& l) { return l.first == &decl; });
+    return iter == local_places.end() ? placement::STACK : iter->second;
+}
+
+void local_promotion::declare(const symbol& name, const assign_statement* decl, size_t param) {
+    scope.emplace_back(name, vars.size());
+    vars.push_back(variable{ decl, param, pos, pos });
+    pos++;
+}
+
+ptrdiff_t local_promotion::find(const symbol& name) const {
+    auto iter = std::find_if(scope.rbegin(), scope.rend(),
+                             [&name](const auto& s) { return s.first == name; });
+    return iter == scope.rend() ? -1 : static_cast<ptrdiff_t>(iter->second);
+}
+
+void local_promotion::read(const symbol& name) {
+    auto idx = find(name);
+    if(idx < 0)
+        return;
+    auto& v = vars[idx];
+    v.end = pos++;
+    v.read = true;
+    v.weight += loop_weight();
+    // The value has to survive the jump back to the loop start
+    for(auto& l : loops) {
+        if(v.start < l.start)
+            l.reads.push_back(idx);
+    }
+}
+
+uint64_t local_promotion::loop_weight() const {
+    return uint64_t{ 1 } << (3 * std::min<size_t>(loops.size(), 6));
+}
+
+void local_promotion::visit(const binop_expression& bop) {
+    bool swap = order.right_first(bop);
+    (swap ? bop.get_right() : bop.get_left())->accept(*this);
+    (swap ? bop.get_left() : bop.get_right())->accept(*this);
+}
+
+void local_promotion::visit(const unarop_expression& unop) { unop.get_exp()->accept(*this); }
+
+void local_promotion::visit(const literal_expression&) {}
+
+void local_promotion::visit(const identifier_expression& id) { read(id.get_identificator()); }
+
+void local_promotion::visit(const function_call& fc) {
+    const auto& args = fc.get_arg_list();
+    for(size_t k : order.operand_order(fc))
+        (k == args.size() ? fc.get_func() : args[k])->accept(*this);
+    calls.push_back(pos++);
+}
+
+void local_promotion::visit(const subscript_expression& sub) {
+    sub.get_pointer()->accept(*this);
+    sub.get_index()->accept(*this);
+}
+
+void local_promotion::visit(const subscript_assign_statement& sub) {
+    sub.get_pointer()->accept(*this);
+    sub.get_index()->accept(*this);
+    sub.get_exp()->accept(*this);
+}
+
+void local_promotion::visit(const program&) {}
+
+void local_promotion::visit(const block_statement& b) {
+    block_starts.push_back(scope.size());
+    for(const auto& st : b.get_statements())
+        st->accept(*this);
+    scope.resize(block_starts.back());
+    block_starts.pop_back();
+}
+
+void local_promotion::visit(const return_statement& ret) {
+    if(ret.get_exp() != nullptr)
+        ret.get_exp()->accept(*this);
+}
+
+void local_promotion::visit(const assign_statement& stm) {
+    // The declared name is visible in its own initializer, as in code_visitor
+    if(stm.get_type() != nullptr)
+        declare(stm.get_identifier(), &stm, 0);
+    auto idx = find(stm.get_identifier());
+
+    if(stm.get_exp() != nullptr) {
+        stm.get_exp()->accept(*this);
+        if(stm.get_type() != nullptr && idx >= 0 && vars[idx].read)
+            vars[idx].read_uninitialized = true;
+    }
+    if(idx < 0)
+        return;
+    if(stm.get_type() != nullptr)
+        vars[idx].start = pos;
+    vars[idx].weight += loop_weight();
+    pos++;
+}
+
+void local_promotion::visit(const if_statement& stm) {
+    stm.get_condition()->accept(*this);
+    stm.get_then_block()->accept(*this);
+    if(stm.get_else_block() != nullptr)
+        stm.get_else_block()->accept(*this);
+}
+
+void local_promotion::visit(const while_statement& stm) {
+    loops.push_back(loop{ pos });
+    stm.get_condition()->accept(*this);
+    stm.get_block()->accept(*this);
+
+    for(size_t idx : loops.back().reads)
+        vars[idx].end = std::max(vars[idx].end, pos);
+    loops.pop_back();
+    pos++;
+}
+
+void local_promotion::visit(const declaration&) {}
+
+void local_promotion::visit(const function&) {}
+
+} // namespace func
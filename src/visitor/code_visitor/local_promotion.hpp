@@ -0,0 +1,101 @@
+#pragma once
+
+#include "node/function.hpp"
+#include "node/statement.hpp"
+#include "symbol.hpp"
+#include "visitor/code_visitor/evaluation_order.hpp"
+#include "visitor/visitor.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace func {
+
+// Picks the parameters and locals of a function that code_visitor keeps in
+// registers instead of stack slots. Walks the body in the order the code is
+// emitted, operands as evaluation_order puts them, numbering the reads of
+// every variable and the calls. A variable lives across a call when one
+// happens between its declaration and its last read, a loop counting as a
+// read up to its end when it reads a variable declared before it. Variables
+// are promoted by use count, loops weighing more: the ones no call
+// interrupts to caller-saved registers, the others to callee-saved ones,
+// which the function saves and restores on every call, so they only take
+// variables used often enough.
+class local_promotion : public visitor<void> {
+    public:
+    enum class placement : char { STACK, CALLER_SAVED, CALLEE_SAVED };
+
+    private:
+    struct variable {
+        // Declaration of a local, null for a parameter
+        const assign_statement* decl;
+        size_t param;
+        uint32_t start;
+        uint32_t end;
+        uint64_t weight{ 0 };
+        bool read{ false };
+        // Read by its own initializer, before the register holds anything
+        bool read_uninitialized{ false };
+    };
+
+    struct loop {
+        uint32_t start;
+        // Variables declared before the loop and read in it
+        std::vector<size_t> reads{};
+    };
+
+    std::vector<variable> vars;
+    // Visible variables, innermost last, and where every open block starts
+    std::vector<std::pair<symbol, size_t>> scope;
+    std::vector<size_t> block_starts;
+    std::vector<loop> loops;
+    std::vector<uint32_t> calls;
+    uint32_t pos = 0;
+    const evaluation_order& order;
+
+    std::vector<placement> param_places;
+    std::vector<std::pair<const assign_statement*, placement>> local_places;
+
+    public:
+    // CALLER_SAVED and CALLEE_SAVED are the numbers of registers of either
+    // kind variables of the function may take
+    local_promotion(const function& f,
+                    const evaluation_order& order,
+                    uint8_t caller_saved,
+                    uint8_t callee_saved);
+
+    placement place(size_t param) const { return param_places[param]; }
+    placement place(const assign_statement& decl) const;
+    // The locals kept in registers, with their kind of register
+    const std::vector<std::pair<const assign_statement*, placement>>& promoted_locals() const {
+        return local_places;
+    }
+
+    void visit(const binop_expression&) override;
+    void visit(const unarop_expression&) override;
+    void visit(const literal_expression&) override;
+    void visit(const identifier_expression&) override;
+    void visit(const function_call&) override;
+    void visit(const subscript_expression&) override;
+
+    void visit(const subscript_assign_statement&) override;
+    void visit(const program&) override;
+    void visit(const block_statement&) override;
+    void visit(const return_statement&) override;
+    void visit(const assign_statement&) override;
+    void visit(const if_statement&) override;
+    void visit(const while_statement&) override;
+    void visit(const declaration&) override;
+    void visit(const function&) override;
+
+    private:
+    void declare(const symbol& name, const assign_statement* decl, size_t param);
+    // Index in vars of the visible variable NAME, -1 for a function
+    ptrdiff_t find(const symbol& name) const;
+    void read(const symbol& name);
+    uint64_t loop_weight() const;
+};
+
+} // namespace func
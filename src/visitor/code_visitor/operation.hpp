@@ -49,14 +49,6 @@ expr_result expr_neq(instr::instruction_writer& w,
                      reg_allocator& alloc,
                      const expr_result& a,
                      const expr_result& b);
-expr_result expr_or(instr::instruction_writer& w,
-                    reg_allocator& alloc,
-                    const expr_result& a,
-                    const expr_result& b);
-expr_result expr_and(instr::instruction_writer& w,
-                     reg_allocator& alloc,
-                     const expr_result& a,
-                     const expr_result& b);
 
 expr_result
 expr_minus(instr::instruction_writer& w, reg_allocator& alloc, const expr_result& a);
@@ -16,20 +16,38 @@ class reg_allocator {
     x31 - stack head points to curr value
     x30 - stack bottom
     x29 - return register
-    ...
+    x17..x28 - callee-saved, variables living across calls
+    x1..x16 - caller-saved, temporaries and variables no call interrupts,
+              x1..x4 pass the first arguments
     x0 - always 0
     */
     const static uint8_t GENERAL_USE_REGISTER_NUM = 32 - 3;
     std::array<bool, GENERAL_USE_REGISTER_NUM> regs{};
+    // Registers of variables, taken from the top of their range. A pinned
+    // register is in use while an expression borrows it, for as many
+    // borrows as it has.
+    std::array<bool, GENERAL_USE_REGISTER_NUM> pinned{};
+    std::array<uint8_t, GENERAL_USE_REGISTER_NUM> borrows{};
 
     private:
     func::stream_proxy& alloc_out;
 
     public:
+    static constexpr uint8_t ARG_REGISTER_NUM = 4;
+    static constexpr uint8_t LAST_CALLER_SAVED = 16;
+    static constexpr uint8_t CALLEE_SAVED_NUM = GENERAL_USE_REGISTER_NUM - 1 - LAST_CALLER_SAVED;
+    // Caller-saved registers variables may take, the argument registers
+    // are left for the parameters to be moved out of
+    static constexpr uint8_t CALLER_SAVED_VARIABLE_NUM = LAST_CALLER_SAVED - ARG_REGISTER_NUM;
+
     reg_allocator(func::stream_proxy& out) : alloc_out{ out } {}
 
+    // Register of argument ARG, starting from 0
+    static uint8_t arg_register(size_t arg) { return static_cast<uint8_t>(arg + 1); }
+
+    // Temporaries are caller-saved
     uint8_t alloc() {
-        for(int i = 1; i < regs.size(); i++) {
+        for(int i = 1; i <= LAST_CALLER_SAVED; i++) {
             if(!regs[i]) {
                 alloc_out << "# ALLOC: " << std::to_string(i) << "\n";
                 regs[i] = true;
@@ -40,7 +58,7 @@ class reg_allocator {
     }
 
     uint8_t alloc(const std::string& reason) {
-        for(int i = 1; i < regs.size(); i++) {
+        for(int i = 1; i <= LAST_CALLER_SAVED; i++) {
             if(!regs[i]) {
                 alloc_out << "# ALLOC: " << std::to_string(i) << " " << reason << "\n";
                 regs[i] = true;
@@ -50,16 +68,74 @@ class reg_allocator {
         throw not_enough_registers_exception{};
     }
 
+    // Takes REG, which has to be free
+    void take(uint8_t reg, const std::string& reason) {
+        alloc_out << "# ALLOC: " << std::to_string(reg) << " " << reason << "\n";
+        assert(!regs[reg]);
+        regs[reg] = true;
+    }
+
+    uint8_t free_count() const {
+        uint8_t count = 0;
+        for(int i = 1; i <= LAST_CALLER_SAVED; i++)
+            count += regs[i] ? 0 : 1;
+        return count;
+    }
+
+    uint8_t pin(bool callee_saved, const std::string& reason) {
+        int first = callee_saved ? LAST_CALLER_SAVED + 1 : ARG_REGISTER_NUM + 1;
+        int last = callee_saved ? regs.size() - 1 : LAST_CALLER_SAVED;
+        for(int i = last; i >= first; i--) {
+            if(!regs[i]) {
+                alloc_out << "# PIN: " << std::to_string(i) << " " << reason << "\n";
+                regs[i] = pinned[i] = true;
+                return i;
+            }
+        }
+        throw not_enough_registers_exception{};
+    }
+
+    void unpin(uint8_t reg) {
+        alloc_out << "# UNPIN: " << std::to_string(reg) << "\n";
+        assert(pinned[reg] && borrows[reg] == 0);
+        regs[reg] = pinned[reg] = false;
+    }
+
+    bool is_pinned(uint8_t reg) const { return pinned[reg]; }
+
+    // Expression results held in REG
+    uint8_t use_count(uint8_t reg) const {
+        if(pinned[reg])
+            return borrows[reg];
+        return regs[reg] ? 1 : 0;
+    }
+
+    // Uses the pinned REG as an expression result, dealloc gives it back
+    uint8_t borrow(uint8_t reg) {
+        assert(pinned[reg]);
+        borrows[reg]++;
+        return reg;
+    }
+
+    static bool is_callee_saved(uint8_t reg) { return reg > LAST_CALLER_SAVED; }
+
+    // Caller-saved registers whose values are in use: temporaries and
+    // borrowed variables
     std::vector<uint8_t> get_allocated_regs() {
         std::vector<uint8_t> allocated;
-        for(int i = 1; i < regs.size(); i++) {
-            if(regs[i])
+        for(int i = 1; i <= LAST_CALLER_SAVED; i++) {
+            if(pinned[i] ? borrows[i] > 0 : regs[i])
                 allocated.push_back(i);
         }
         return allocated;
     }
 
     void dealloc(uint8_t reg) {
+        if(pinned[reg]) {
+            assert(borrows[reg] > 0);
+            borrows[reg]--;
+            return;
+        }
         alloc_out << "# RELEASE: " << std::to_string(reg) << "\n";
         assert(regs[reg] == true);
         regs[reg] = false;
@@ -0,0 +1,93 @@
+#include "visitor/llvm_visitor/llvm_jit.hpp"
+#include "exception.hpp"
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+namespace func {
+
+using namespace llvm;
+
+namespace {
+
+// In-process counterparts of stdlib/stdfunc.ll
+int32_t func_write(int32_t c) {
+    char ch = static_cast<char>(c);
+    return static_cast<int32_t>(::write(STDOUT_FILENO, &ch, 1));
+}
+
+int32_t func_read() {
+    unsigned char ch = 0;
+    auto n = ::read(STDIN_FILENO, &ch, 1);
+    return n == 1 ? ch : static_cast<int32_t>(n);
+}
+
+void func_exit(int32_t code) {
+    std::exit(code);
+}
+
+template <typename T> T unwrap(Expected<T> value) {
+    if(!value)
+        throw codegen_exception{ "JIT: " + toString(value.takeError()) };
+    return std::move(*value);
+}
+
+void unwrap(Error err) {
+    if(err)
+        throw codegen_exception{ "JIT: " + toString(std::move(err)) };
+}
+
+} // namespace
+
+const std::vector<std::string>& runtime_functions() {
+    static const std::vector<std::string> names{ "write", "read", "exit" };
+    return names;
+}
+
+int run_jit(orc::ThreadSafeModule tsm) {
+    tsm.withModuleDo([](Module& m) {
+        Function* main_func = m.getFunction("main");
+        if(main_func == nullptr || main_func->empty() ||
+           !main_func->getReturnType()->isVoidTy() || main_func->arg_size() != 0)
+            throw global_syntax_exception{ "main must be a (void-void) function" };
+    });
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser(); // stdlib uses inline asm
+
+    auto jit = unwrap(orc::LLJITBuilder().create());
+    orc::JITDylib& jd = jit->getMainJITDylib();
+
+    orc::SymbolMap runtime;
+    runtime[jit->mangleAndIntern("write")] = {
+        orc::ExecutorAddr::fromPtr(&func_write), JITSymbolFlags::Exported
+    };
+    runtime[jit->mangleAndIntern("read")] = {
+        orc::ExecutorAddr::fromPtr(&func_read), JITSymbolFlags::Exported
+    };
+    runtime[jit->mangleAndIntern("exit")] = {
+        orc::ExecutorAddr::fromPtr(&func_exit), JITSymbolFlags::Exported
+    };
+    unwrap(jd.define(orc::absoluteSymbols(std::move(runtime))));
+
+    // Anything else (e.g. memcpy emitted by LLVM) comes from the process
+    jd.addGenerator(unwrap(orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+    jit->getDataLayout().getGlobalPrefix())));
+
+    unwrap(jit->addIRModule(std::move(tsm)));
+
+    auto* main_ptr = unwrap(jit->lookup("main")).toPtr<void (*)()>();
+    // write bypasses the streams, so what the compiler printed goes first
+    std::cout.flush();
+    main_ptr();
+    return 0;
+}
+
+} // namespace func
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+
+#include <string>
+#include <vector>
+
+namespace func {
+
+// Functions of the stdlib run_jit defines in-process. The module must only
+// declare them, so exit goes through std::exit and flushes the compiler's output.
+const std::vector<std::string>& runtime_functions();
+
+// Compiles the module in-process with ORC LLJIT and calls its main.
+// write/read/exit resolve to the compiler's own implementations,
+// so neither nasm nor a linker is needed.
+// Returns 0 when main returns. A program calling exit doesn't return here:
+// the process ends with its exit code.
+int run_jit(llvm::orc::ThreadSafeModule tsm);
+
+} // namespace func
@@ -7,14 +7,40 @@
 #include "utils.hpp"
 #include "visitor/sym_table.hpp"
 #include "llvm/IR/Verifier.h"
+#include <llvm/Bitcode/BitcodeWriter.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/DiagnosticInfo.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/InstIterator.h>
 #include <llvm/IR/InstrTypes.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Value.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/TargetParser/SubtargetFeature.h>
+#include <llvm/Transforms/IPO/Internalize.h>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <sstream>
 #include <variant>
 
 namespace func {
@@ -23,17 +49,612 @@ void llvm_visitor::visit(const program& node) {
     for(const auto& func : node.get_funcs()) {
         func->accept(*this);
     }
-    module.print(code_out, nullptr);
 }
 
+void llvm_visitor::init_target_machine() {
+    // Batch mode creates visitors on several threads at once
+    static std::once_flag target_initialized;
+    std::call_once(target_initialized, []() {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        InitializeNativeTargetAsmParser(); // stdlib uses inline asm
+    });
+
+    std::string triple = sys::getDefaultTargetTriple();
+    std::string error;
+    const Target* target = TargetRegistry::lookupTarget(triple, error);
+    if(target == nullptr)
+        throw codegen_exception{ "can't find target for " + triple + ": " + error };
+
+    CodeGenOptLevel cg_level = CodeGenOptLevel::Default;
+    if(options.opt_level == OptimizationLevel::O0)
+        cg_level = CodeGenOptLevel::None;
+    else if(options.opt_level == OptimizationLevel::O1)
+        cg_level = CodeGenOptLevel::Less;
+    else if(options.opt_level == OptimizationLevel::O3)
+        cg_level = CodeGenOptLevel::Aggressive;
+
+    SubtargetFeatures features;
+    if(options.cpu == "native") {
+        options.cpu = sys::getHostCPUName().str();
+        StringMap<bool> host_features;
+        if(sys::getHostCPUFeatures(host_features)) {
+            for(const auto& feature : host_features)
+                features.AddFeature(feature.getKey(), feature.getValue());
+        }
+    }
+    SmallVector<StringRef, 8> extra_features;
+    StringRef{ options.features }.split(extra_features, ',', -1, false);
+    for(StringRef feature : extra_features)
+        features.AddFeature(feature.trim());
+    options.features = features.getString();
+
+    target_machine.reset(target->createTargetMachine(triple, options.cpu, options.features,
+                                                     TargetOptions{}, Reloc::PIC_,
+                                                     std::nullopt, cg_level));
+
+    // Optimization passes should see the same layout as the backend
+    module->setTargetTriple(triple);
+    module->setDataLayout(target_machine->createDataLayout());
+}
+
+namespace {
+
+// Internal function writing the profile of --instrument-functions
+const char* const profile_writer_name = "func.prof.write";
+
+} // namespace
+
+void llvm_visitor::instrument_functions() {
+    if(!options.instrument_functions)
+        return;
+
+    // FunC definitions only, the stdlib is not profiled
+    std::vector<Function*> functions;
+    for(Function& f : *module) {
+        if(function_locations.count(&f) != 0)
+            functions.push_back(&f);
+    }
+
+    // Matches %func_prof_record of stdfunc.ll: name, calls,
+    // inclusive cycles, exclusive cycles, recursion depth
+    Type* i64 = Type::getInt64Ty(*ctx);
+    Type* ptr = PointerType::get(*ctx, 0);
+    StructType* record_type = StructType::get(*ctx, { ptr, i64, i64, i64, i64 });
+    Constant* zero = ConstantInt::get(i64, 0);
+    std::vector<Constant*> records;
+    for(Function* f : functions) {
+        Constant* name = ConstantDataArray::getString(*ctx, f->getName());
+        auto* name_global = new GlobalVariable(*module, name->getType(), true,
+                                               GlobalValue::PrivateLinkage, name, "prof.name");
+        name_global->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        records.push_back(ConstantStruct::get(record_type, { name_global, zero, zero, zero, zero }));
+    }
+    auto* records_type = ArrayType::get(record_type, records.size());
+    auto* records_global =
+    new GlobalVariable(*module, records_type, false, GlobalValue::InternalLinkage,
+                       ConstantArray::get(records_type, records), "prof.records");
+    // Cycles spent in the callees of the running function so far
+    auto* callee_cycles = new GlobalVariable(*module, i64, false, GlobalValue::InternalLinkage,
+                                             zero, "prof.callee_cycles");
+    Function* cycle_counter = Intrinsic::getDeclaration(module.get(), Intrinsic::readcyclecounter);
+
+    auto field = [&](size_t record, unsigned index) {
+        Constant* indices[] = { builder.getInt32(0), builder.getInt32(record),
+                                builder.getInt32(index) };
+        return ConstantExpr::getInBoundsGetElementPtr(records_type, records_global, indices);
+    };
+    auto add = [&](IRBuilder<>& b, Constant* counter, Value* value) {
+        Value* sum = b.CreateAdd(b.CreateLoad(i64, counter), value);
+        b.CreateStore(sum, counter);
+        return sum;
+    };
+
+    for(size_t i = 0; i < functions.size(); i++) {
+        Function* f = functions[i];
+        BasicBlock& entry = f->getEntryBlock();
+        auto pos = entry.getFirstInsertionPt();
+        while(isa<AllocaInst>(*pos))
+            ++pos;
+        IRBuilder<> entry_builder{ &entry, pos };
+        add(entry_builder, field(i, 1), ConstantInt::get(i64, 1));
+        add(entry_builder, field(i, 4), ConstantInt::get(i64, 1));
+        Value* saved_cycles = entry_builder.CreateLoad(i64, callee_cycles, "prof.saved");
+        entry_builder.CreateStore(zero, callee_cycles);
+        Value* start = entry_builder.CreateCall(cycle_counter, {}, "prof.start");
+
+        // Code after the calls in tail position also keeps them from becoming musttail,
+        // so every return is seen
+        std::vector<ReturnInst*> returns;
+        for(BasicBlock& block : *f) {
+            if(auto* ret = dyn_cast<ReturnInst>(block.getTerminator()))
+                returns.push_back(ret);
+        }
+        for(ReturnInst* ret : returns) {
+            IRBuilder<> ret_builder{ ret };
+            Value* elapsed =
+            ret_builder.CreateSub(ret_builder.CreateCall(cycle_counter), start, "prof.elapsed");
+            Value* in_callees = ret_builder.CreateLoad(i64, callee_cycles);
+            add(ret_builder, field(i, 3), ret_builder.CreateSub(elapsed, in_callees));
+            // Recursive calls are inside the outermost one, which alone counts as inclusive
+            Value* depth = add(ret_builder, field(i, 4), ConstantInt::getSigned(i64, -1));
+            Value* outermost = ret_builder.CreateICmpEQ(depth, zero);
+            add(ret_builder, field(i, 2), ret_builder.CreateSelect(outermost, elapsed, zero));
+            ret_builder.CreateStore(ret_builder.CreateAdd(saved_cycles, elapsed), callee_cycles);
+        }
+    }
+
+    auto* writer = Function::Create(FunctionType::get(Type::getVoidTy(*ctx), false),
+                                    GlobalValue::InternalLinkage, profile_writer_name, *module);
+    writer->addFnAttr(Attribute::Cold);
+    writer->addFnAttr(Attribute::NoInline);
+    FunctionCallee dump = module->getOrInsertFunction("__func_prof_dump", Type::getVoidTy(*ctx),
+                                                      ptr, Type::getInt32Ty(*ctx), ptr);
+    IRBuilder<> writer_builder{ BasicBlock::Create(*ctx, "entry", writer) };
+    Constant* path = ConstantPointerNull::get(PointerType::get(*ctx, 0));
+    if(!options.instrument_output.empty())
+        path = writer_builder.CreateGlobalStringPtr(options.instrument_output, "prof.path");
+    writer_builder.CreateCall(dump, { records_global, writer_builder.getInt32(functions.size()), path });
+    writer_builder.CreateRetVoid();
+
+    // The profile of main itself is complete once its counters are updated
+    Function* main_func = module->getFunction("main");
+    if(main_func == nullptr || main_func->isDeclaration())
+        return;
+    for(BasicBlock& block : *main_func) {
+        if(auto* ret = dyn_cast<ReturnInst>(block.getTerminator()))
+            IRBuilder<>{ ret }.CreateCall(writer);
+    }
+}
+
+void llvm_visitor::link_library(const std::string& path,
+                                const std::vector<std::string>& provided) {
+    SMDiagnostic diag;
+    std::unique_ptr<Module> library = parseIRFile(path, diag, *ctx);
+    if(library == nullptr)
+        throw codegen_exception{ "can't load library " + path + ": " + diag.getMessage().str() };
+
+    library->setTargetTriple(module->getTargetTriple());
+    library->setDataLayout(module->getDataLayout());
+    for(const auto& name : provided) {
+        if(Function* f = library->getFunction(name))
+            f->deleteBody();
+    }
+
+    // Only what the module declares is linked in. Linked definitions are
+    // internalized, so unused ones are dropped after inlining.
+    bool failed = Linker::linkModules(
+    *module, std::move(library), Linker::Flags::LinkOnlyNeeded,
+    [](Module& m, const StringSet<>& linked) {
+        internalizeModule(m, [&linked](const GlobalValue& gv) {
+            return !gv.hasName() || linked.count(gv.getName()) == 0;
+        });
+    });
+    if(failed)
+        throw codegen_exception{ "can't link library " + path };
+}
+
+void llvm_visitor::optimize_module() {
+    finalize_debug_info();
+    write_function_profile_on_exit();
+    set_calling_conventions();
+
+    std::optional<PGOOptions> pgo;
+    if(!options.profile_generate.empty()) {
+        pgo = PGOOptions(options.profile_generate, "", "", "", vfs::getRealFileSystem(),
+                         PGOOptions::IRInstr);
+        flush_profile_on_exit();
+    } else if(!options.profile_use.empty()) {
+        pgo = PGOOptions(options.profile_use, "", "", "", vfs::getRealFileSystem(),
+                         PGOOptions::IRUse);
+    }
+
+    if(options.opt_level == OptimizationLevel::O0 && !pgo)
+        return;
+
+    LoopAnalysisManager lam;
+    FunctionAnalysisManager mfam;
+    CGSCCAnalysisManager cgam;
+    ModuleAnalysisManager mam;
+
+    // The target machine gives the vectorizers the real vector widths and costs
+    PassBuilder pb{ target_machine.get(), PipelineTuningOptions{}, pgo, &pic };
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(mfam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, mfam, cgam, mam);
+
+    // The O0 pipeline still instruments, but ignores a profile to use
+    if(options.opt_level == OptimizationLevel::O0) {
+        ModulePassManager mpm = pb.buildO0DefaultPipeline(options.opt_level);
+        mpm.run(*module, mam);
+        return;
+    }
+
+    ModulePassManager mpm = pb.buildPerModuleDefaultPipeline(options.opt_level);
+    mpm.run(*module, mam);
+}
+
+namespace {
+
+// Whether PTR is only loaded from, directly or through GEPs
+bool only_read(Value* ptr, const Instruction* copy) {
+    for(User* user : ptr->users()) {
+        if(user == copy || isa<LoadInst>(user))
+            continue;
+        if(auto* gep = dyn_cast<GetElementPtrInst>(user); gep && only_read(gep, copy))
+            continue;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+void llvm_visitor::fold_read_only_strings() {
+    // Runs after mem2reg, so strings held in local variables are visible
+    // as direct uses. Anything stored, passed or written through keeps its copy.
+    for(auto& str : string_copies) {
+        if(!only_read(str.slot, str.copy))
+            continue;
+        str.copy->eraseFromParent();
+        str.slot->replaceAllUsesWith(str.global);
+        str.slot->eraseFromParent();
+    }
+    string_copies.clear();
+}
+
+void llvm_visitor::set_calling_conventions() {
+    // In a whole program nothing but main is called from outside
+    Function* main_func = module->getFunction("main");
+    if(options.whole_program && main_func != nullptr && !main_func->isDeclaration()) {
+        for(Function& f : *module) {
+            if(!f.isDeclaration() && &f != main_func)
+                f.setLinkage(GlobalValue::InternalLinkage);
+        }
+    }
+
+    for(Function& f : *module) {
+        // Other modules and function typed values call with the C convention
+        if(f.isDeclaration() || !f.hasLocalLinkage() || f.hasAddressTaken())
+            continue;
+        f.setCallingConv(CallingConv::Fast);
+        for(User* user : f.users()) {
+            if(auto* call = dyn_cast<CallBase>(user); call && call->getCalledOperand() == &f)
+                call->setCallingConv(CallingConv::Fast);
+        }
+    }
+
+    // Tail calls between equal signatures are guaranteed, so recursion
+    // through them runs in constant stack even at O0
+    for(Function& f : *module) {
+        for(Instruction& inst : instructions(f)) {
+            auto* call = dyn_cast<CallInst>(&inst);
+            if(call == nullptr || !call->isTailCall() || !isa<ReturnInst>(call->getNextNode()))
+                continue;
+            Function* callee = call->getCalledFunction();
+            if(callee != nullptr && callee->getFunctionType() == f.getFunctionType() &&
+               callee->getCallingConv() == f.getCallingConv())
+                call->setTailCallKind(CallInst::TCK_MustTail);
+        }
+    }
+}
+
+void llvm_visitor::flush_profile_on_exit() {
+    // exit of the stdlib is a bare syscall, so the atexit handler of the
+    // profile runtime never runs. Write the counters before it instead.
+    Function* exit_func = module->getFunction("exit");
+    if(exit_func == nullptr || exit_func->isDeclaration())
+        return;
+    FunctionCallee write_profile =
+    module->getOrInsertFunction("__llvm_profile_write_file", Type::getInt32Ty(*ctx));
+    IRBuilder<> exit_builder{ &*exit_func->getEntryBlock().getFirstInsertionPt() };
+    exit_builder.CreateCall(write_profile);
+}
+
+void llvm_visitor::write_function_profile_on_exit() {
+    // Same as for the PGO counters, exit never returns to main
+    Function* writer = module->getFunction(profile_writer_name);
+    Function* exit_func = module->getFunction("exit");
+    if(writer == nullptr || exit_func == nullptr)
+        return;
+    if(!exit_func->isDeclaration()) {
+        IRBuilder<> exit_builder{ &*exit_func->getEntryBlock().getFirstInsertionPt() };
+        exit_builder.CreateCall(writer);
+        return;
+    }
+    // exit comes from the JIT, so the profile is written before every call
+    for(User* user : exit_func->users()) {
+        if(auto* call = dyn_cast<CallBase>(user); call && call->getCalledOperand() == exit_func)
+            IRBuilder<>{ call }.CreateCall(writer);
+    }
+}
+
+void llvm_visitor::emit_module() {
+    switch(options.emit) {
+    case emit_type::LL: module->print(code_out, nullptr); break;
+    case emit_type::BC: WriteBitcodeToFile(*module, code_out); break;
+    case emit_type::ASM:
+    case emit_type::OBJ: {
+        // Codegen needs a seekable stream, so the file is built in memory first
+        SmallVector<char, 0> buffer;
+        raw_svector_ostream buffer_out{ buffer };
+        legacy::PassManager pm;
+        auto file_type = options.emit == emit_type::OBJ ? CodeGenFileType::ObjectFile :
+                                                          CodeGenFileType::AssemblyFile;
+        if(target_machine->addPassesToEmitFile(pm, buffer_out, nullptr, file_type))
+            throw codegen_exception{ "target machine can't emit a file of this type" };
+        pm.run(*module);
+        code_out.write(buffer.data(), buffer.size());
+        break;
+    }
+    }
+    code_out.flush();
+}
+
+
+size_t llvm_visitor::function_count() const {
+    return count_if(*module, [](const Function& f) { return !f.isDeclaration(); });
+}
+
+size_t llvm_visitor::instruction_count() const {
+    size_t count = 0;
+    for(const Function& f : *module)
+        count += f.getInstructionCount();
+    return count;
+}
+
+namespace {
+
+// Prints the remarks of the passes matching the --Rpass* regexes to stderr,
+// at the FunC location they come from
+class remark_handler : public DiagnosticHandler {
+    std::optional<Regex> passed;
+    std::optional<Regex> missed;
+    std::optional<Regex> analysis;
+    const std::unordered_map<const Function*, yy::location>& function_locations;
+
+    static std::optional<Regex> make_regex(const std::string& pattern) {
+        if(pattern.empty())
+            return std::nullopt;
+        return Regex{ pattern };
+    }
+
+    // The instruction location when there is debug info, the function otherwise
+    std::string remark_location(const DiagnosticInfoOptimizationBase& remark) const {
+        if(remark.isLocationAvailable()) {
+            auto loc = remark.getLocation();
+            return loc.getRelativePath().str() + ":" + std::to_string(loc.getLine()) + "." +
+            std::to_string(loc.getColumn());
+        }
+        auto iter = function_locations.find(&remark.getFunction());
+        if(iter == function_locations.end())
+            return remark.getFunction().getName().str();
+        std::ostringstream os;
+        os << iter->second;
+        return os.str();
+    }
+
+    public:
+    remark_handler(const llvm_options& options,
+                   const std::unordered_map<const Function*, yy::location>& function_locations)
+    : passed{ make_regex(options.remarks_passed) }, missed{ make_regex(options.remarks_missed) },
+      analysis{ make_regex(options.remarks_analysis) }, function_locations{ function_locations } {}
+
+    bool isPassedOptRemarkEnabled(StringRef pass) const override {
+        return passed && passed->match(pass);
+    }
+    bool isMissedOptRemarkEnabled(StringRef pass) const override {
+        return missed && missed->match(pass);
+    }
+    bool isAnalysisRemarkEnabled(StringRef pass) const override {
+        return analysis && analysis->match(pass);
+    }
+    bool isAnyRemarkEnabled() const override {
+        return passed || missed || analysis;
+    }
+
+    bool handleDiagnostics(const DiagnosticInfo& info) override {
+        const auto* remark = dyn_cast<DiagnosticInfoOptimizationBase>(&info);
+        if(remark == nullptr)
+            return false;
+        // Remarks only the YAML file asked for end up here too
+        if(!remark->isEnabled())
+            return true;
+        std::string flag = remark->isPassed() ? "-Rpass" :
+                           remark->isMissed() ? "-Rpass-missed" :
+                                                "-Rpass-analysis";
+        std::string line = remark_location(*remark) + ": remark: " + remark->getMsg() + " [" +
+                           flag + "=" + remark->getPassName().str() + "]\n";
+        // One write, so remarks of --batch workers don't interleave
+        errs() << line;
+        return true;
+    }
+};
+
+// Name of the function or module a pass runs on, for trace events
+std::string ir_unit_name(const Any& ir) {
+    if(const auto* f = any_cast<const Function*>(&ir))
+        return (*f)->getName().str();
+    if(const auto* m = any_cast<const Module*>(&ir))
+        return (*m)->getName().str();
+    return "";
+}
+
+} // namespace
+
+llvm_visitor::debug_location::debug_location(llvm_visitor& visitor, const yy::location& loc)
+: builder{ visitor.builder }, previous{ visitor.builder.getCurrentDebugLocation() } {
+    if(visitor.debug_scopes.empty())
+        return;
+    builder.SetCurrentDebugLocation(DILocation::get(*visitor.ctx, loc.begin.line, loc.begin.column,
+                                                    visitor.debug_scopes.back()));
+}
+
+llvm_visitor::debug_unit& llvm_visitor::get_debug_unit(const yy::location& loc) {
+    std::string name = loc.begin.filename != nullptr ? *loc.begin.filename : "-";
+    auto iter = debug_units.find(name);
+    if(iter != debug_units.end())
+        return iter->second;
+
+    if(debug_units.empty()) {
+        module->addModuleFlag(Module::Warning, "Dwarf Version", 5);
+        module->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
+    }
+    SmallString<256> path{ name };
+    sys::fs::make_absolute(path);
+
+    debug_unit unit;
+    unit.builder = std::make_unique<DIBuilder>(*module);
+    unit.file =
+    unit.builder->createFile(sys::path::filename(path), sys::path::parent_path(path));
+    // DWARF has no code for FunC, C is the closest for debuggers
+    unit.unit = unit.builder->createCompileUnit(dwarf::DW_LANG_C, unit.file, "FunC compiler",
+                                                options.opt_level != OptimizationLevel::O0,
+                                                "", 0);
+    return debug_units.emplace(name, std::move(unit)).first->second;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+DIType* llvm_visitor::get_debug_type(debug_unit& unit, const func::type* t) {
+    auto iter = unit.types.find(t);
+    if(iter != unit.types.end())
+        return iter->second;
+
+    DIBuilder& dib = *unit.builder;
+    uint64_t ptr_size = module->getDataLayout().getPointerSizeInBits();
+    DIType* res = nullptr;
+    switch(t->get_type()) {
+    case types::INT: res = dib.createBasicType("int", 32, dwarf::DW_ATE_signed); break;
+    case types::BOOL: res = dib.createBasicType("bool", 8, dwarf::DW_ATE_boolean); break;
+    case types::STRING:
+        // Characters are stored as i32
+        res = dib.createPointerType(dib.createBasicType("char", 32, dwarf::DW_ATE_UTF), ptr_size);
+        break;
+    case types::VOID: break;
+    case types::FUNCTION:
+        res = dib.createPointerType(
+        get_debug_function_type(unit, dynamic_cast<const function_type&>(*t)), ptr_size);
+        break;
+    }
+    unit.types.emplace(t, res);
+    return res;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+DISubroutineType* llvm_visitor::get_debug_function_type(debug_unit& unit, const function_type& t) {
+    // The return type goes first, void is null
+    std::vector<Metadata*> elements{ get_debug_type(unit, t.get_return_type()) };
+    const auto& signature = t.get_signature();
+    if(signature.front()->get_type() != types::VOID) {
+        for(size_t i = 0; i + 1 < signature.size(); i++)
+            elements.push_back(get_debug_type(unit, signature[i]));
+    }
+    return unit.builder->createSubroutineType(unit.builder->getOrCreateTypeArray(elements));
+}
+
+void llvm_visitor::begin_debug_function(const function& node, Function* f) {
+    if(!options.debug_info)
+        return;
+    current_debug_unit = &get_debug_unit(node.get_loc());
+    auto& unit = *current_debug_unit;
+
+    const auto& sym = table.find(node.get_identifier());
+    auto* fn_type = get_debug_function_type(unit, dynamic_cast<const function_type&>(*sym.type_obj));
+    unsigned line = node.get_loc().begin.line;
+    DISubprogram* sp = unit.builder->createFunction(
+    unit.file, node.get_identifier().str(), "", unit.file, line, fn_type, line,
+    DINode::FlagPrototyped, DISubprogram::SPFlagDefinition);
+    f->setSubprogram(sp);
+    debug_scopes.push_back(sp);
+}
+
+void llvm_visitor::end_debug_function() {
+    if(!options.debug_info)
+        return;
+    current_debug_unit->builder->finalizeSubprogram(cast<DISubprogram>(debug_scopes.front()));
+    debug_scopes.clear();
+    current_debug_unit = nullptr;
+    builder.SetCurrentDebugLocation(DebugLoc{});
+}
+
+void llvm_visitor::declare_debug_variable(symbol name,
+                                          const func::type* t,
+                                          Value* slot,
+                                          const yy::location& loc,
+                                          unsigned arg_no) {
+    if(debug_scopes.empty())
+        return;
+    auto& unit = *current_debug_unit;
+    DIScope* scope = debug_scopes.back();
+    unsigned line = loc.begin.line;
+    DILocalVariable* var = arg_no != 0 ?
+    unit.builder->createParameterVariable(scope, name.str(), arg_no, unit.file, line,
+                                          get_debug_type(unit, t), true) :
+    unit.builder->createAutoVariable(scope, name.str(), unit.file, line, get_debug_type(unit, t), true);
+    unit.builder->insertDeclare(slot, var, unit.builder->createExpression(),
+                                DILocation::get(*ctx, line, loc.begin.column, scope),
+                                builder.GetInsertBlock());
+}
+
+void llvm_visitor::finalize_debug_info() {
+    for(auto& [name, unit] : debug_units)
+        unit.builder->finalize();
+}
+
+void llvm_visitor::init_remarks() {
+    if(!options.remarks_passed.empty() || !options.remarks_missed.empty() ||
+       !options.remarks_analysis.empty()) {
+        ctx->setDiagnosticHandler(std::make_unique<remark_handler>(options, function_locations));
+    }
+    if(options.remarks_output.empty())
+        return;
+    auto file = setupLLVMOptimizationRemarks(*ctx, options.remarks_output,
+                                             options.remarks_filter, "yaml", false);
+    if(!file)
+        throw codegen_exception{ "can't write remarks to " + options.remarks_output + ": " +
+                                 toString(file.takeError()) };
+    remarks_file = std::move(*file);
+    remarks_file->keep();
+}
+
+void llvm_visitor::detach_remarks() {
+    ctx->setDiagnosticHandler(std::make_unique<DiagnosticHandler>());
+    ctx->setLLVMRemarkStreamer(nullptr);
+    ctx->setMainRemarkStreamer(nullptr);
+}
+
+void llvm_visitor::instrument_passes() {
+    if(options.report != nullptr) {
+        time_report* report = options.report;
+        pic.registerBeforeNonSkippedPassCallback([report](StringRef pass, Any) {
+            report->begin(pass, time_report::kind::PASS);
+        });
+        pic.registerAfterPassCallback(
+        [report](StringRef, Any, const PreservedAnalyses&) { report->end(); });
+        pic.registerAfterPassInvalidatedCallback(
+        [report](StringRef, const PreservedAnalyses&) { report->end(); });
+    }
+    // The profiler is per thread, so a visitor traces if its thread does
+    if(timeTraceProfilerEnabled()) {
+        pic.registerBeforeNonSkippedPassCallback([](StringRef pass, Any ir) {
+            timeTraceProfilerBegin(pass, ir_unit_name(ir));
+        });
+        pic.registerAfterPassCallback(
+        [](StringRef, Any, const PreservedAnalyses&) { timeTraceProfilerEnd(); });
+        pic.registerAfterPassInvalidatedCallback(
+        [](StringRef, const PreservedAnalyses&) { timeTraceProfilerEnd(); });
+    }
+}
 
 Type* llvm_visitor::llvm_get_type(types t) {
     switch(t) {
-    case types::INT: return Type::getInt32Ty(ctx);
-    case types::STRING: return PointerType::get(ctx, 0);
-    case types::BOOL: return Type::getIntNTy(ctx, 1);
-    case types::VOID: return Type::getVoidTy(ctx);
-    case types::FUNCTION: return PointerType::get(ctx, 0);
+    case types::INT: return Type::getInt32Ty(*ctx);
+    case types::STRING: return PointerType::get(*ctx, 0);
+    case types::BOOL: return Type::getIntNTy(*ctx, 1);
+    case types::VOID: return Type::getVoidTy(*ctx);
+    case types::FUNCTION: return PointerType::get(*ctx, 0);
     default: panic(1, "Invalid type in llvm_get_type: %d", t);
     }
 }
@@ -49,10 +670,10 @@ void llvm_visitor::visit(const declaration& node) {
     FunctionType* ft = FunctionType::get(result_type, params_type, false);
 
     // Check if its already exists
-    if(Function* fm = module.getFunction(node.get_identifier())) {
+    if(Function* fm = module->getFunction(node.get_identifier().str())) {
         auto sym = table.find(node.get_identifier());
         if(ft != fm->getFunctionType()) {
-            throw symbol_redeclaration_exception{ sym.name, node.get_loc(), sym.declare_loc };
+            throw symbol_redeclaration_exception{ sym.name.str(), node.get_loc(), sym.declare_loc };
         }
         result = fm;
         return;
@@ -60,21 +681,24 @@ void llvm_visitor::visit(const declaration& node) {
 
     // Otherwise create new
     Function* f = Function::Create(ft, Function::LinkageTypes::ExternalLinkage,
-                                   node.get_identifier(), module);
+                                   node.get_identifier().str(), *module);
+    f->addFnAttr("target-cpu", options.cpu);
+    if(!options.features.empty())
+        f->addFnAttr("target-features", options.features);
 
     // register it in sym_table
-    auto signature = std::vector<unique_ptr<type>>();
+    auto signature = std::vector<const type*>();
     if(node.get_params().empty())
-        signature.push_back(std::make_unique<void_type>());
+        signature.push_back(type_context::get_void());
     else
         for(const auto& p : node.get_params()) {
-            signature.push_back(p.get_type()->clone());
+            signature.push_back(p.get_type());
         }
-    signature.push_back(node.get_result_type()->clone());
+    signature.push_back(node.get_result_type());
 
     auto info =
     llvm_sym_info{ node.get_identifier(),
-                   std::make_unique<func::function_type>(std::move(signature)),
+                   type_context::get_function(std::move(signature)),
                    std::nullopt };
     table.add(std::move(info));
 
@@ -82,6 +706,7 @@ void llvm_visitor::visit(const declaration& node) {
 }
 
 void llvm_visitor::visit(const function& node) {
+    TimeTraceScope trace{ "Codegen function", node.get_identifier().str() };
     Function* f = std::get<Function*>(node.get_declaration()->accept_with_result(*this));
 
     if(node.get_block() == nullptr) {
@@ -90,12 +715,14 @@ void llvm_visitor::visit(const function& node) {
     }
 
     if (!f->empty()){
-        throw syntax_exception{ "Multiple defenition of function '" + node.get_identifier() + "'.",
+        throw syntax_exception{ "Multiple defenition of function '" + node.get_identifier().str() + "'.",
                                 node.get_loc() };
     }
+    function_locations[f] = node.get_loc();
 
-    BasicBlock* bb = BasicBlock::Create(ctx, "entry", f);
+    BasicBlock* bb = BasicBlock::Create(*ctx, "entry", f);
     builder.SetInsertPoint(bb);
+    begin_debug_function(node, f);
 
     table.start_block(); // start
     IRBuilder<> temp_b(&f->getEntryBlock(), f->getEntryBlock().begin());
@@ -105,11 +732,14 @@ void llvm_visitor::visit(const function& node) {
         const auto& param = node.get_params()[i];
 
         Value* alloc = temp_b.CreateAlloca(llvm_get_type(param.get_type()->get_type()),
-                                           nullptr, param.get_identifier());
+                                           nullptr, param.get_identifier().str());
         builder.CreateStore(&arg, alloc);
+        // Parameters have no location of their own
+        declare_debug_variable(param.get_identifier(), param.get_type(), alloc,
+                               node.get_loc(), i + 1);
 
         // Registering in sym_table
-        table.add(llvm_sym_info{ param.get_identifier(), param.get_type()->clone(), alloc });
+        table.add(llvm_sym_info{ param.get_identifier(), param.get_type(), alloc });
 
         i++;
     }
@@ -125,9 +755,12 @@ void llvm_visitor::visit(const function& node) {
     // Insert return for a root non basic block of a function if needed
     Instruction* terminator = bb->getTerminator();
     if(terminator == nullptr && f->getReturnType()->isVoidTy()) {
+        yy::location end_loc{ node.get_loc().end };
+        debug_location location{ *this, end_loc };
         builder.SetInsertPoint(bb);
         builder.CreateRetVoid();
     }
+    end_debug_function();
 
     // Verify the function body
     std::string error_msg;
@@ -137,12 +770,18 @@ void llvm_visitor::visit(const function& node) {
     }
 
     fpm.run(*f, fam);
+    fold_read_only_strings();
 
     result = f;
 }
 
 void llvm_visitor::visit(const block_statement& node) {
     table.start_block(); // start
+    if(!debug_scopes.empty()) {
+        auto& unit = *current_debug_unit;
+        debug_scopes.push_back(unit.builder->createLexicalBlock(
+        debug_scopes.back(), unit.file, node.get_loc().begin.line, node.get_loc().begin.column));
+    }
 
     for(const auto& st : node.get_statements()) {
         st->accept(*this);
@@ -151,6 +790,8 @@ void llvm_visitor::visit(const block_statement& node) {
             break;
     }
 
+    if(!debug_scopes.empty())
+        debug_scopes.pop_back();
     table.end_block(); // end
 };
 
@@ -172,6 +813,7 @@ FunctionType* llvm_visitor::llvm_get_function_type(const function_type& func_typ
 
 
 void llvm_visitor::visit(const function_call& node) {
+    debug_location location{ *this, node.get_loc() };
     auto func = node.get_func()->accept_with_result(*this);
 
     const function_type& func_type = std::holds_alternative<TypedFunctionPtr>(func) ?
@@ -192,7 +834,7 @@ void llvm_visitor::visit(const function_call& node) {
     std::vector<Value*> argsV;
     for(int i = 0; i < node.get_arg_list().size(); i++) {
         auto arg = turn_to_typed_value_ptr(args[i]->accept_with_result(*this));
-        expect_types(*func_type.get_signature()[i], *arg.type_obj, args[i]->get_loc());
+        expect_types(func_type.get_signature()[i], arg.type_obj, args[i]->get_loc());
         argsV.push_back(arg.ptr);
     }
 
@@ -200,77 +842,95 @@ void llvm_visitor::visit(const function_call& node) {
     if(std::holds_alternative<TypedFunctionPtr>(func)) {
         Function* function = std::get<TypedFunctionPtr>(func).ptr;
         result = TypedValuePtr{ builder.CreateCall(function, argsV),
-                                func_type.get_return_type()->clone() };
+                                func_type.get_return_type() };
     } else {
         Value* function = std::get<TypedValuePtr>(func).ptr;
         result =
         TypedValuePtr{ builder.CreateCall(llvm_get_function_type(func_type), function, argsV),
-                       func_type.get_return_type()->clone() };
+                       func_type.get_return_type() };
     }
 }
 
 void llvm_visitor::visit(const identifier_expression& node) {
-    auto sym = table.find(node.get_identificator());
+    debug_location location{ *this, node.get_loc() };
+    const auto& sym = table.find(node.get_identificator());
 
     if(sym.type_obj->get_type() == types::FUNCTION && !sym.value.has_value()) {
-        auto* f = module.getFunction(sym.name);
+        auto* f = module->getFunction(sym.name.str());
         assert(f);
-        result = TypedFunctionPtr{ f, std::move(sym.type_obj) };
+        result = TypedFunctionPtr{ f, sym.type_obj };
         return;
     }
 
     // if it's a value, it must be on the stack
     result =
     TypedValuePtr{ builder.CreateLoad(llvm_get_type(sym.type_obj->get_type()),
-                                      sym.value.value(), node.get_identificator()),
-                   std::move(sym.type_obj) };
+                                      sym.value.value(), node.get_identificator().str()),
+                   sym.type_obj };
 };
 
 void llvm_visitor::visit(const literal_expression& lit) {
+    debug_location location{ *this, lit.get_loc() };
     func::lit_val val = lit.get_val();
 
     if(auto* v = std::get_if<int>(&val)) {
-        Value* res = ConstantInt::get(ctx, APInt(32, *v, true));
-        result = TypedValuePtr{ res, std::make_unique<int_type>() };
+        Value* res = ConstantInt::get(*ctx, APInt(32, *v, true));
+        result = TypedValuePtr{ res, type_context::get_int() };
     } else if(auto* v = std::get_if<bool>(&val)) {
         int boolified_int = *v ? 1 : 0;
-        Value* res = ConstantInt::get(ctx, APInt(1, boolified_int, false));
-        result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+        Value* res = ConstantInt::get(*ctx, APInt(1, boolified_int, false));
+        result = TypedValuePtr{ res, type_context::get_bool() };
     } else if(auto* v = std::get_if<std::string>(&val)) {
-        ArrayType* arr_ty = ArrayType::get(llvm_get_type(types::INT), v->length() + 1); // Size with null terminator
-        AllocaInst* stack_str = builder.CreateAlloca(arr_ty, nullptr, "stack_str");
-
-        for(int i = 0; i < v->length() + 1; ++i) {
-            auto* idx = ConstantInt::get(llvm_get_type(types::INT), i);
-            auto* gep =
-            builder.CreateGEP(arr_ty, stack_str,
-                              { ConstantInt::get(llvm_get_type(types::INT), 0), idx },
-                              "str_" + std::to_string(i));
-
-            char symbol = '\0';
-            if(i != v->length())
-                symbol = (*v)[i];
-            builder.CreateStore(ConstantInt::get(llvm_get_type(types::INT), symbol), gep);
-        }
+        std::vector<uint32_t> chars;
+        for(char symbol : *v)
+            chars.push_back(static_cast<uint32_t>(symbol));
+        chars.push_back(0); // null terminator
+        Constant* init = ConstantDataArray::get(*ctx, chars);
+
+        auto* global_str = new GlobalVariable(*module, init->getType(), true,
+                                              GlobalValue::PrivateLinkage, init, "str");
+        global_str->setUnnamedAddr(GlobalValue::UnnamedAddr::Global);
+        global_str->setAlignment(Align(4));
+
+        // Strings are mutable, so every evaluation gets a fresh copy. The slot
+        // lives in the entry block, otherwise a loop would grow the stack.
+        Function* f = builder.GetInsertBlock()->getParent();
+        IRBuilder<> temp_b(&f->getEntryBlock(), f->getEntryBlock().begin());
+        AllocaInst* stack_str = temp_b.CreateAlloca(init->getType(), nullptr, "stack_str");
+        stack_str->setAlignment(Align(4));
+        CallInst* copy = builder.CreateMemCpy(stack_str, Align(4), global_str, Align(4),
+                                              chars.size() * sizeof(uint32_t));
+        string_copies.push_back({ stack_str, copy, global_str });
 
         Value* res = builder.CreateBitCast(stack_str, llvm_get_type(types::STRING));
-        result = TypedValuePtr{ res, std::make_unique<string_type>() };
+        result = TypedValuePtr{ res, type_context::get_string() };
     }
 };
 
 void llvm_visitor::visit(const return_statement& node) {
+    debug_location location{ *this, node.get_loc() };
     if(node.get_exp() == nullptr) {
         Value* res = builder.CreateRetVoid();
-        result = TypedValuePtr{ res, std::make_unique<void_type>() };
+        result = TypedValuePtr{ res, type_context::get_void() };
         return;
     }
 
     auto ret = std::get<TypedValuePtr>(node.get_exp()->accept_with_result(*this));
+    // A call returned as is is in tail position. String arguments may point
+    // to allocas of the caller, so such calls keep their frame.
+    if(auto* call = dyn_cast<CallInst>(ret.ptr)) {
+        bool passes_stack_memory = any_of(call->args(), [](const Use& arg) {
+            return arg->getType()->isPointerTy() && !isa<Function>(arg);
+        });
+        if(!passes_stack_memory)
+            call->setTailCall();
+    }
     Value* res = builder.CreateRet(ret.ptr);
-    result = TypedValuePtr{ res, ret.type_obj->clone() };
+    result = TypedValuePtr{ res, ret.type_obj };
 };
 
 void llvm_visitor::visit(const assign_statement& node) {
+    debug_location location{ *this, node.get_loc() };
     /*
     3 Variants:
     int a;
@@ -285,10 +945,12 @@ void llvm_visitor::visit(const assign_statement& node) {
         Function* f = builder.GetInsertBlock()->getParent();
         IRBuilder<> temp_b(&f->getEntryBlock(), f->getEntryBlock().begin());
         Value* alloc = temp_b.CreateAlloca(llvm_get_type(node.get_type()->get_type()),
-                                           nullptr, node.get_identifier());
+                                           nullptr, node.get_identifier().str());
+
+        declare_debug_variable(node.get_identifier(), node.get_type(), alloc, node.get_loc());
 
         // add to sym_table
-        table.add(llvm_sym_info{ node.get_identifier(), node.get_type()->clone(), alloc });
+        table.add(llvm_sym_info{ node.get_identifier(), node.get_type(), alloc });
     }
 
     // evaluate expression and save result
@@ -297,11 +959,11 @@ void llvm_visitor::visit(const assign_statement& node) {
 
     const llvm_sym_info& sym = table.find(node.get_identifier());
     if (!sym.value.has_value()) {
-        throw syntax_exception{ "assignment to declared function '" + sym.name + "'.", node.get_loc() };
+        throw syntax_exception{ "assignment to declared function '" + sym.name.str() + "'.", node.get_loc() };
     }
 
     auto expr = turn_to_typed_value_ptr(node.get_exp()->accept_with_result(*this));
-    expect_types(*sym.type_obj, *expr.type_obj, node.get_exp()->get_loc());
+    expect_types(sym.type_obj, expr.type_obj, node.get_exp()->get_loc());
     builder.CreateStore(expr.ptr, sym.value.value());
 };
 
@@ -312,14 +974,20 @@ TypedValuePtr llvm_visitor::turn_to_typed_value_ptr(llvm_result res) {
 
     if(std::holds_alternative<TypedFunctionPtr>(res)) {
         auto f = std::move(std::get<TypedFunctionPtr>(res));
-        Value* ptr = builder.CreateBitCast(f.ptr, PointerType::get(ctx, 0));
-        return TypedValuePtr{ ptr, std::move(f.type_obj) };
+        Value* ptr = builder.CreateBitCast(f.ptr, PointerType::get(*ctx, 0));
+        return TypedValuePtr{ ptr, f.type_obj };
     }
 
     throw global_syntax_exception{ "Can't turn result into typed value." };
 }
 
 void llvm_visitor::visit(const binop_expression& node) {
+    debug_location location{ *this, node.get_loc() };
+    if(node.get_op() == binop::OR || node.get_op() == binop::AND) {
+        short_circuit(node);
+        return;
+    }
+
     auto lv = turn_to_typed_value_ptr(node.get_left()->accept_with_result(*this));
     auto rv = turn_to_typed_value_ptr(node.get_right()->accept_with_result(*this));
 
@@ -337,58 +1005,50 @@ void llvm_visitor::visit(const binop_expression& node) {
     try {
         switch(node.get_op()) {
         case binop::ADD:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateAdd(lv.ptr, rv.ptr, "addtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         case binop::SUB:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateSub(lv.ptr, rv.ptr, "subtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         case binop::MUL:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateMul(lv.ptr, rv.ptr, "multmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         case binop::DIV:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateSDiv(lv.ptr, rv.ptr, "divtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         case binop::MOD:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateSRem(lv.ptr, rv.ptr, "modtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         case binop::LESS:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateICmp(CmpInst::ICMP_SLT, lv.ptr, rv.ptr, "lstmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_bool() };
             break;
         case binop::GRTR:
-            expect_types(int_type{}, *lv.type_obj, node.get_loc());
+            expect_types(type_context::get_int(), lv.type_obj, node.get_loc());
             res = builder.CreateICmp(CmpInst::ICMP_SGT, lv.ptr, rv.ptr, "grtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_bool() };
             break;
         case binop::EQ:
             res = builder.CreateICmp(CmpInst::ICMP_EQ, lv.ptr, rv.ptr, "eqstmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_bool() };
             break;
         case binop::NEQ:
             res = builder.CreateICmp(CmpInst::ICMP_NE, lv.ptr, rv.ptr, "netmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_bool() };
             break;
         case binop::OR:
-            expect_types(bool_type{}, *lv.type_obj, node.get_loc());
-            res = builder.CreateOr(lv.ptr, rv.ptr, "ortmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
-            break;
-        case binop::AND:
-            expect_types(bool_type{}, *lv.type_obj, node.get_loc());
-            res = builder.CreateAnd(lv.ptr, rv.ptr, "andtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
-            break;
+        case binop::AND: break; // short_circuit
         }
     } catch(unexpected_type_exception& e) {
         e.loc = node.get_loc();
@@ -396,7 +1056,40 @@ void llvm_visitor::visit(const binop_expression& node) {
     }
 };
 
+void llvm_visitor::short_circuit(const binop_expression& node) {
+    bool is_and = node.get_op() == binop::AND;
+
+    auto lv = turn_to_typed_value_ptr(node.get_left()->accept_with_result(*this));
+    expect_types(type_context::get_bool(), lv.type_obj, node.get_loc());
+
+    Function* function = builder.GetInsertBlock()->getParent();
+    BasicBlock* leftb = builder.GetInsertBlock();
+    BasicBlock* rightb = BasicBlock::Create(*ctx, is_and ? "and_rhs" : "or_rhs", function);
+    BasicBlock* endb = BasicBlock::Create(*ctx, is_and ? "and_end" : "or_end");
+
+    // The right operand only runs when the left one doesn't decide
+    if(is_and)
+        builder.CreateCondBr(lv.ptr, rightb, endb);
+    else
+        builder.CreateCondBr(lv.ptr, endb, rightb);
+
+    builder.SetInsertPoint(rightb);
+    auto rv = turn_to_typed_value_ptr(node.get_right()->accept_with_result(*this));
+    expect_types(type_context::get_bool(), rv.type_obj, node.get_loc());
+    // Nested && and || move the insertion point to their own end block
+    rightb = builder.GetInsertBlock();
+    builder.CreateBr(endb);
+
+    function->insert(function->end(), endb);
+    builder.SetInsertPoint(endb);
+    PHINode* phi = builder.CreatePHI(llvm_get_type(types::BOOL), 2, is_and ? "andtmp" : "ortmp");
+    phi->addIncoming(builder.getInt1(!is_and), leftb);
+    phi->addIncoming(rv.ptr, rightb);
+    this->result = TypedValuePtr{ phi, type_context::get_bool() };
+}
+
 void llvm_visitor::visit(const unarop_expression& node) {
+    debug_location location{ *this, node.get_loc() };
     auto expr = node.get_exp()->accept_with_result(*this);
 
     if(std::holds_alternative<TypedFunctionPtr>(expr)) {
@@ -409,17 +1102,17 @@ void llvm_visitor::visit(const unarop_expression& node) {
     try {
         switch(node.get_op()) {
         case unarop::MINUS: {
-            expect_types(int_type{}, *val.type_obj, node.get_loc());
-            Value* zero = ConstantInt::get(ctx, APInt(32, 0, true));
+            expect_types(type_context::get_int(), val.type_obj, node.get_loc());
+            Value* zero = ConstantInt::get(*ctx, APInt(32, 0, true));
             res = builder.CreateSub(zero, val.ptr, "negtmp");
-            this->result = TypedValuePtr{ res, std::make_unique<int_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_int() };
             break;
         }
         case unarop::NOT: {
-            expect_types(bool_type{}, *val.type_obj, node.get_loc());
-            Value* one = ConstantInt::get(ctx, APInt(1, 1, true));
+            expect_types(type_context::get_bool(), val.type_obj, node.get_loc());
+            Value* one = ConstantInt::get(*ctx, APInt(1, 1, true));
             res = builder.CreateXor(one, val.ptr, "nottmp");
-            this->result = TypedValuePtr{ res, std::make_unique<bool_type>() };
+            this->result = TypedValuePtr{ res, type_context::get_bool() };
             break;
         }
         }
@@ -438,17 +1131,18 @@ void CreateBrIfNotTerminated(IRBuilder<>& builder, BasicBlock* dest) {
 } // namespace
 
 void llvm_visitor::visit(const if_statement& node) {
+    debug_location location{ *this, node.get_loc() };
 
     TypedValuePtr cond =
     std::get<TypedValuePtr>(node.get_condition()->accept_with_result(*this));
 
-    expect_types(bool_type{}, *cond.type_obj, node.get_loc());
+    expect_types(type_context::get_bool(), cond.type_obj, node.get_loc());
 
     Function* function = builder.GetInsertBlock()->getParent();
 
-    BasicBlock* thenb = BasicBlock::Create(ctx, "then", function);
-    BasicBlock* elseb = BasicBlock::Create(ctx, "else");
-    BasicBlock* mergeb = BasicBlock::Create(ctx, "ifend");
+    BasicBlock* thenb = BasicBlock::Create(*ctx, "then", function);
+    BasicBlock* elseb = BasicBlock::Create(*ctx, "else");
+    BasicBlock* mergeb = BasicBlock::Create(*ctx, "ifend");
 
     builder.CreateCondBr(cond.ptr, thenb, elseb);
 
@@ -468,18 +1162,19 @@ void llvm_visitor::visit(const if_statement& node) {
 }
 
 void llvm_visitor::visit(const while_statement& node) {
+    debug_location location{ *this, node.get_loc() };
 
     Function* function = builder.GetInsertBlock()->getParent();
 
-    BasicBlock* condb = BasicBlock::Create(ctx, "while_cond", function);
-    BasicBlock* loopb = BasicBlock::Create(ctx, "while_loop");
-    BasicBlock* endb = BasicBlock::Create(ctx, "while_end");
+    BasicBlock* condb = BasicBlock::Create(*ctx, "while_cond", function);
+    BasicBlock* loopb = BasicBlock::Create(*ctx, "while_loop");
+    BasicBlock* endb = BasicBlock::Create(*ctx, "while_end");
 
     builder.CreateBr(condb);
     builder.SetInsertPoint(condb);
     TypedValuePtr cond =
     std::get<TypedValuePtr>(node.get_condition()->accept_with_result(*this));
-    expect_types(bool_type{}, *cond.type_obj, node.get_loc());
+    expect_types(type_context::get_bool(), cond.type_obj, node.get_loc());
     builder.CreateCondBr(cond.ptr, loopb, endb);
 
     function->insert(function->end(), loopb);
@@ -493,11 +1188,12 @@ void llvm_visitor::visit(const while_statement& node) {
 
 
 void llvm_visitor::visit(const subscript_expression& node) {
+    debug_location location{ *this, node.get_loc() };
     auto ptr = std::get<TypedValuePtr>(node.get_pointer()->accept_with_result(*this));
-    expect_types(string_type{}, *ptr.type_obj, node.get_loc());
+    expect_types(type_context::get_string(), ptr.type_obj, node.get_loc());
 
     auto idx = std::get<TypedValuePtr>(node.get_index()->accept_with_result(*this));
-    expect_types(int_type{}, *idx.type_obj, node.get_loc());
+    expect_types(type_context::get_int(), idx.type_obj, node.get_loc());
 
     Value* elem_i_ptr = builder.CreateGEP(llvm_get_type(types::INT), ptr.ptr,
                                           { idx.ptr }, "array_elem_ptr");
@@ -505,19 +1201,20 @@ void llvm_visitor::visit(const subscript_expression& node) {
     Value* loaded_val =
     builder.CreateLoad(llvm_get_type(types::INT), elem_i_ptr, "loaded_elem");
 
-    this->result = TypedValuePtr{ loaded_val, std::make_unique<int_type>() };
+    this->result = TypedValuePtr{ loaded_val, type_context::get_int() };
 };
 
 void llvm_visitor::visit(const subscript_assign_statement& node) {
+    debug_location location{ *this, node.get_loc() };
 
     auto ptr = std::get<TypedValuePtr>(node.get_pointer()->accept_with_result(*this));
-    expect_types(string_type{}, *ptr.type_obj, node.get_loc());
+    expect_types(type_context::get_string(), ptr.type_obj, node.get_loc());
 
     auto idx = std::get<TypedValuePtr>(node.get_index()->accept_with_result(*this));
-    expect_types(int_type{}, *idx.type_obj, node.get_loc());
+    expect_types(type_context::get_int(), idx.type_obj, node.get_loc());
 
     auto expr = std::get<TypedValuePtr>(node.get_exp()->accept_with_result(*this));
-    expect_types(int_type{}, *expr.type_obj, node.get_loc());
+    expect_types(type_context::get_int(), expr.type_obj, node.get_loc());
 
     Value* elem_i_ptr = builder.CreateGEP(llvm_get_type(types::INT), ptr.ptr,
                                           { idx.ptr }, "array_elem_ptr");
@@ -2,16 +2,25 @@
 
 #include "codegen/location.hh"
 #include "printer.hpp"
+#include "time_report.hpp"
 #include "type/type.hpp"
 #include "visitor/sym_table.hpp"
 #include "visitor/visitor.hpp"
 #include "llvm/IR/Value.h"
 #include "llvm/Transforms/Utils/Mem2Reg.h"
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
 #include <llvm/IR/PassManager.h>
+#include <llvm/Passes/OptimizationLevel.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
 #include <optional>
+#include <unordered_map>
 #include <utility>
 #include <variant>
 
@@ -20,58 +29,131 @@ namespace func {
 using namespace llvm;
 
 struct llvm_sym_info {
-    std::string name;
-    std::unique_ptr<func::type> type_obj;
+    symbol name;
+    const func::type* type_obj{ nullptr };
     std::optional<Value*> value;
     yy::location declare_loc;
-    bool is_delimeter = false;
 
     public:
-    llvm_sym_info(std::string name,
-                  const std::unique_ptr<func::type>& type_obj,
+    llvm_sym_info(symbol name,
+                  const func::type* type_obj,
                   std::optional<Value*> value,
-                  yy::location declare_loc = yy::location{},
-                  bool is_delimeter = false)
-    : name{ std::move(name) }, type_obj{ type_obj->clone() }, value{ value },
-      declare_loc{ declare_loc }, is_delimeter{ is_delimeter } {}
+                  yy::location declare_loc = yy::location{})
+    : name{ name }, type_obj{ type_obj }, value{ value },
+      declare_loc{ declare_loc } {}
     llvm_sym_info() = default;
-    llvm_sym_info(const llvm_sym_info& sym)
-    : name{ sym.name }, value{ sym.value }, declare_loc{ sym.declare_loc },
-      is_delimeter{ sym.is_delimeter } {
-        if(sym.type_obj != nullptr)
-            type_obj = sym.type_obj->clone();
-    }
 };
 
 struct TypedValuePtr {
     Value* ptr;
-    std::unique_ptr<type> type_obj;
+    const type* type_obj;
 };
 
 struct TypedFunctionPtr {
     Function* ptr;
-    std::unique_ptr<type> type_obj;
+    const type* type_obj;
 };
 
 using llvm_result = std::variant<TypedValuePtr, TypedFunctionPtr, Function*>;
 
+enum class emit_type : char { LL, BC, ASM, OBJ };
+
+struct llvm_options {
+    // O0 keeps the per-function mem2reg only, anything else runs
+    // the standard module pipeline before the module is emitted.
+    OptimizationLevel opt_level{ OptimizationLevel::O0 };
+    // ASM and OBJ are produced by a host TargetMachine in-process.
+    emit_type emit{ emit_type::LL };
+    // CPU to tune for, "native" stands for the host CPU and its features.
+    std::string cpu{ "generic" };
+    // Comma separated features on top of the CPU ones, e.g. "+avx2,-avx512f".
+    std::string features;
+    // Raw profile the instrumented program writes, empty if not instrumenting.
+    std::string profile_generate;
+    // Indexed profile (llvm-profdata merge) the pipeline optimizes with.
+    std::string profile_use;
+    // Gets the time of every pass run when set.
+    time_report* report{ nullptr };
+    // Regexes of the passes whose applied, missed and analysis remarks
+    // are printed to stderr, empty for none.
+    std::string remarks_passed;
+    std::string remarks_missed;
+    std::string remarks_analysis;
+    // YAML file for the remarks of the passes matching remarks_filter
+    // (all passes if it's empty), no file if empty.
+    std::string remarks_output;
+    std::string remarks_filter;
+    // DWARF for every source, with locations of the AST nodes and variables.
+    bool debug_info{ false };
+    // Counts the calls and cycles of every FunC function, the flat profile
+    // is written to instrument_output (stderr if empty) when the program ends.
+    bool instrument_functions{ false };
+    std::string instrument_output;
+    // The module is the whole program, so if it defines main its other
+    // functions are made internal. Off by default, as other objects built
+    // apart may call them.
+    bool whole_program{ false };
+};
+
 class llvm_visitor : public visitor<llvm_result> {
     private:
     func::stream_proxy& debug_out;
     func::llvm_stream_proxy code_out;
     llvm_result result;
     sym_table<llvm_sym_info> table;
-    LLVMContext ctx;
-    Module module{ "func module", ctx };
-    IRBuilder<> builder{ ctx };
+    // Must outlive the context that streams remarks into it
+    std::unique_ptr<ToolOutputFile> remarks_file;
+    std::unique_ptr<LLVMContext> ctx{ std::make_unique<LLVMContext>() };
+    std::unique_ptr<Module> module{ std::make_unique<Module>("func module", *ctx) };
+    IRBuilder<> builder{ *ctx };
+    PassInstrumentationCallbacks pic;
     FunctionPassManager fpm;
     FunctionAnalysisManager fam;
+    llvm_options options;
+    std::unique_ptr<TargetMachine> target_machine;
+    // String literals of the current function copied to the stack
+    struct string_copy {
+        AllocaInst* slot;
+        CallInst* copy;
+        GlobalVariable* global;
+    };
+    std::vector<string_copy> string_copies;
+    // Where the functions of the module are defined, for remarks
+    std::unordered_map<const Function*, yy::location> function_locations;
+    // A DIBuilder makes a single compile unit, so every source has its own
+    struct debug_unit {
+        std::unique_ptr<DIBuilder> builder;
+        DICompileUnit* unit;
+        DIFile* file;
+        std::unordered_map<const func::type*, DIType*> types;
+    };
+    // By source file name, empty without options.debug_info
+    std::unordered_map<std::string, debug_unit> debug_units;
+    // Subprogram of the current function and its lexical blocks
+    std::vector<DIScope*> debug_scopes;
+    debug_unit* current_debug_unit{ nullptr };
+
+    // Gives the instructions built while it lives the location of a node
+    class debug_location {
+        IRBuilder<>& builder;
+        DebugLoc previous;
+
+        public:
+        debug_location(llvm_visitor& visitor, const yy::location& loc);
+        debug_location(const debug_location&) = delete;
+        debug_location& operator=(const debug_location&) = delete;
+        ~debug_location() { builder.SetCurrentDebugLocation(previous); }
+    };
 
     public:
-    llvm_visitor(func::printer& printer)
-    : debug_out{ printer.debug }, code_out{ llvm_stream_proxy{ printer.code } } {
+    llvm_visitor(func::printer& printer, llvm_options options = {})
+    : debug_out{ printer.debug }, code_out{ llvm_stream_proxy{ printer.code } },
+      options{ options } {
+        init_target_machine();
+        init_remarks();
+        instrument_passes();
         fpm.addPass(PromotePass());
-        PassBuilder PB;
+        PassBuilder PB{ target_machine.get(), PipelineTuningOptions{}, std::nullopt, &pic };
         PB.registerFunctionAnalyses(fam);
     }
 
@@ -95,10 +177,59 @@ class llvm_visitor : public visitor<llvm_result> {
 
     llvm_result&& extract_result() override { return std::move(result); }
 
+    // Run once all programs of the module are visited.
+    // Pulls the definitions the module needs out of a bitcode library,
+    // the ones named in PROVIDED stay declarations, e.g. for the JIT.
+    // Instruments the functions for options.instrument_functions,
+    // before linking, as the profile is written by the stdlib.
+    void instrument_functions();
+    void link_library(const std::string& path, const std::vector<std::string>& provided = {});
+    void optimize_module();
+    void emit_module();
+    // Defined functions and their instructions currently in the module
+    size_t function_count() const;
+    size_t instruction_count() const;
+    // Hands the module over, e.g. to the JIT. The visitor is unusable after.
+    orc::ThreadSafeModule take_module() {
+        detach_remarks();
+        return orc::ThreadSafeModule{ std::move(module), std::move(ctx) };
+    }
+
     private:
     Type* llvm_get_type(types t);
     FunctionType* llvm_get_function_type(const function_type& func_type);
     TypedValuePtr turn_to_typed_value_ptr(llvm_result res);
+    // && and || skip their right operand once the left one decides.
+    void short_circuit(const binop_expression& node);
+    // Sets the module triple and data layout, resolves options.cpu
+    // and options.features to what the functions get as attributes.
+    void init_target_machine();
+    // Drops the stack copies of literals the function only reads.
+    void fold_read_only_strings();
+    // Internal linkage and fastcc for everything but main, musttail where possible.
+    void set_calling_conventions();
+    void flush_profile_on_exit();
+    void write_function_profile_on_exit();
+    // Debug info of the function being built and its variables.
+    // Do nothing without options.debug_info.
+    debug_unit& get_debug_unit(const yy::location& loc);
+    DIType* get_debug_type(debug_unit& unit, const func::type* t);
+    DISubroutineType* get_debug_function_type(debug_unit& unit, const function_type& t);
+    void begin_debug_function(const function& node, Function* f);
+    void end_debug_function();
+    void declare_debug_variable(symbol name,
+                                const func::type* t,
+                                Value* slot,
+                                const yy::location& loc,
+                                unsigned arg_no = 0);
+    void finalize_debug_info();
+    // Routes the remarks options ask for to stderr and the YAML file.
+    void init_remarks();
+    // The context outlives the visitor after take_module.
+    void detach_remarks();
+    // Reports every pass run through pic to options.report
+    // and to the time trace profiler.
+    void instrument_passes();
 };
 
 } // namespace func
@@ -39,11 +39,11 @@ std::unordered_map<func::unarop, std::string> unarop_name = { { func::unarop::MI
                                                               { func::unarop::NOT, "!" } };
 } // namespace
 
-void print_visitor::print_type(func::type& type) {
+void print_visitor::print_type(const func::type& type) {
     if(type.get_type() != func::types::FUNCTION)
         out << type_name[type.get_type()];
     else {
-        auto const& _ = dynamic_cast<function_type&>(type);
+        auto const& _ = dynamic_cast<const function_type&>(type);
         out << "<func>";
     }
 }
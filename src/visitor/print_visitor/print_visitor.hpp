@@ -14,7 +14,7 @@ class print_visitor : public visitor<void> {
     std::ostream& out;
     int offset = 0;
 
-    void print_type(func::type&);
+    void print_type(const func::type&);
 
     public:
     print_visitor(std::ostream& ostream) : out{ ostream } {}
@@ -1,47 +1,55 @@
 #pragma once
 
 #include "exception.hpp"
-#include <list>
+#include "symbol.hpp"
+#include <cstddef>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace func {
 
+// Every name maps to a stack of its declarations, innermost last. Each block
+// logs the names it declared and pops exactly those when it ends.
 template <typename SymInfo> class sym_table {
-    std::list<SymInfo> table;
+    // Declarations of a name with the block depth they belong to. A deque
+    // keeps references returned by find valid while shadowing pushes more.
+    using shadow_stack = std::deque<std::pair<std::size_t, SymInfo>>;
+
+    std::unordered_map<symbol, shadow_stack> table;
+    std::vector<symbol> undo_log;
+    // Size of undo_log at the start of every open block
+    std::vector<std::size_t> block_starts;
 
     public:
-    void start_block() {
-        SymInfo delim{};
-        delim.is_delimeter = true;
-        table.push_back(std::move(delim));
-    }
+    void start_block() { block_starts.push_back(undo_log.size()); }
 
     void end_block() {
-        while(!table.back().is_delimeter) {
-            table.pop_back();
+        while(undo_log.size() > block_starts.back()) {
+            auto iter = table.find(undo_log.back());
+            iter->second.pop_back();
+            if(iter->second.empty())
+                table.erase(iter);
+            undo_log.pop_back();
         }
-        table.pop_back();
+        block_starts.pop_back();
     }
 
     void add(SymInfo&& sym) {
-
-        auto iter = table.rbegin();
-        while(iter != table.rend() && !iter->is_delimeter) {
-            if(iter->name == sym.name)
-                throw symbol_redeclaration_exception{ sym.name, iter->declare_loc,
-                                                       sym.declare_loc };
-            iter++;
-        }
-        table.push_back(std::move(sym));
+        shadow_stack& decls = table[sym.name];
+        if(!decls.empty() && decls.back().first == block_starts.size())
+            throw symbol_redeclaration_exception{ sym.name.str(), decls.back().second.declare_loc,
+                                                   sym.declare_loc };
+        undo_log.push_back(sym.name);
+        decls.emplace_back(block_starts.size(), std::move(sym));
     }
 
-    const SymInfo& find(const std::string& sym) {
-        auto iter = table.rbegin();
-        while(iter != table.rend()) {
-            if(!iter->is_delimeter && iter->name == sym)
-                return *iter;
-            iter++;
-        }
-        throw symbol_not_found_exception({ sym, yy::location{} });
+    const SymInfo& find(const symbol& sym) {
+        auto iter = table.find(sym);
+        if(iter == table.end())
+            throw symbol_not_found_exception({ sym.str(), yy::location{} });
+        return iter->second.back().second;
     }
 };
 
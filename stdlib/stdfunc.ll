@@ -0,0 +1,167 @@
+; Linux x86_64 specific
+; Syscall wrappers of the stdlib, linked into user modules as bitcode
+; so the optimizer can inline the syscalls.
+
+define i32 @write(i32 %c) nounwind {
+entry:
+  %buf = alloca i8, align 1
+  %ch = trunc i32 %c to i8
+  store i8 %ch, ptr %buf, align 1
+  ; SYS_WRITE(STD_OUT, buf, 1)
+  %res = call i64 asm sideeffect "syscall", "={rax},{rax},{rdi},{rsi},{rdx},~{rcx},~{r11},~{memory}"(i64 1, i64 1, ptr %buf, i64 1)
+  %ret = trunc i64 %res to i32
+  ret i32 %ret
+}
+
+define i32 @read() nounwind {
+entry:
+  %buf = alloca i8, align 1
+  ; SYS_READ(STD_IN, buf, 1)
+  %res = call i64 asm sideeffect "syscall", "={rax},{rax},{rdi},{rsi},{rdx},~{rcx},~{r11},~{memory}"(i64 0, i64 0, ptr %buf, i64 1)
+  %ok = icmp eq i64 %res, 1
+  br i1 %ok, label %done, label %fail
+
+done:
+  %ch = load i8, ptr %buf, align 1
+  %val = zext i8 %ch to i32
+  ret i32 %val
+
+fail:
+  ; return rax
+  %err = trunc i64 %res to i32
+  ret i32 %err
+}
+
+define void @exit(i32 %code) noreturn nounwind {
+entry:
+  %code64 = sext i32 %code to i64
+  ; SYS_EXIT(code)
+  call void asm sideeffect "syscall", "{rax},{rdi},~{rcx},~{r11},~{memory}"(i64 60, i64 %code64)
+  unreachable
+}
+
+; Runtime of --instrument-functions. The compiler emits a record per
+; instrumented function and calls @__func_prof_dump when main returns
+; or exit is called.
+; Record: name, calls, inclusive cycles, exclusive cycles, recursion depth
+%func_prof_record = type { ptr, i64, i64, i64, i64 }
+
+@__func_prof_header = private unnamed_addr constant [36 x i8] c"calls\09inclusive\09exclusive\09function\0A\00"
+@__func_prof_tab = private unnamed_addr constant [2 x i8] c"\09\00"
+@__func_prof_newline = private unnamed_addr constant [2 x i8] c"\0A\00"
+
+define internal void @__func_prof_write(i32 %fd, ptr %buf, i64 %len) nounwind {
+entry:
+  %fd64 = sext i32 %fd to i64
+  ; SYS_WRITE(fd, buf, len)
+  %res = call i64 asm sideeffect "syscall", "={rax},{rax},{rdi},{rsi},{rdx},~{rcx},~{r11},~{memory}"(i64 1, i64 %fd64, ptr %buf, i64 %len)
+  ret void
+}
+
+define internal void @__func_prof_write_str(i32 %fd, ptr %str) nounwind {
+entry:
+  br label %loop
+
+loop:
+  %len = phi i64 [ 0, %entry ], [ %next, %loop ]
+  %ptr = getelementptr inbounds i8, ptr %str, i64 %len
+  %ch = load i8, ptr %ptr, align 1
+  %next = add i64 %len, 1
+  %end = icmp eq i8 %ch, 0
+  br i1 %end, label %done, label %loop
+
+done:
+  call void @__func_prof_write(i32 %fd, ptr %str, i64 %len)
+  ret void
+}
+
+define internal void @__func_prof_write_u64(i32 %fd, i64 %n) nounwind {
+entry:
+  ; 2^64 has 20 digits, they are filled from the end
+  %buf = alloca [20 x i8], align 1
+  br label %loop
+
+loop:
+  %pos = phi i64 [ 20, %entry ], [ %digit_pos, %loop ]
+  %val = phi i64 [ %n, %entry ], [ %rest, %loop ]
+  %digit_pos = sub i64 %pos, 1
+  %rest = udiv i64 %val, 10
+  %digit = urem i64 %val, 10
+  %digit8 = trunc i64 %digit to i8
+  %ch = add i8 %digit8, 48
+  %ptr = getelementptr inbounds [20 x i8], ptr %buf, i64 0, i64 %digit_pos
+  store i8 %ch, ptr %ptr, align 1
+  %more = icmp ne i64 %rest, 0
+  br i1 %more, label %loop, label %done
+
+done:
+  %len = sub i64 20, %digit_pos
+  call void @__func_prof_write(i32 %fd, ptr %ptr, i64 %len)
+  ret void
+}
+
+; Writes the functions that were called to PATH, or to stderr if it's null
+define void @__func_prof_dump(ptr %records, i32 %count, ptr %path) nounwind {
+entry:
+  %has_path = icmp ne ptr %path, null
+  br i1 %has_path, label %open, label %start
+
+open:
+  ; SYS_OPEN(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)
+  %opened = call i64 asm sideeffect "syscall", "={rax},{rax},{rdi},{rsi},{rdx},~{rcx},~{r11},~{memory}"(i64 2, ptr %path, i64 577, i64 420)
+  %open_ok = icmp sge i64 %opened, 0
+  %opened32 = trunc i64 %opened to i32
+  %file_fd = select i1 %open_ok, i32 %opened32, i32 2
+  br label %start
+
+start:
+  %fd = phi i32 [ 2, %entry ], [ %file_fd, %open ]
+  call void @__func_prof_write_str(i32 %fd, ptr @__func_prof_header)
+  br label %cond
+
+cond:
+  %i = phi i32 [ 0, %start ], [ %next_i, %next ]
+  %more = icmp slt i32 %i, %count
+  br i1 %more, label %body, label %close
+
+body:
+  %rec = getelementptr inbounds %func_prof_record, ptr %records, i32 %i
+  %calls_ptr = getelementptr inbounds %func_prof_record, ptr %rec, i32 0, i32 1
+  %calls = load i64, ptr %calls_ptr, align 8
+  %called = icmp ne i64 %calls, 0
+  br i1 %called, label %print, label %next
+
+print:
+  %name_ptr = getelementptr inbounds %func_prof_record, ptr %rec, i32 0, i32 0
+  %name = load ptr, ptr %name_ptr, align 8
+  %inclusive_ptr = getelementptr inbounds %func_prof_record, ptr %rec, i32 0, i32 2
+  %inclusive = load i64, ptr %inclusive_ptr, align 8
+  %exclusive_ptr = getelementptr inbounds %func_prof_record, ptr %rec, i32 0, i32 3
+  %exclusive = load i64, ptr %exclusive_ptr, align 8
+  call void @__func_prof_write_u64(i32 %fd, i64 %calls)
+  call void @__func_prof_write_str(i32 %fd, ptr @__func_prof_tab)
+  call void @__func_prof_write_u64(i32 %fd, i64 %inclusive)
+  call void @__func_prof_write_str(i32 %fd, ptr @__func_prof_tab)
+  call void @__func_prof_write_u64(i32 %fd, i64 %exclusive)
+  call void @__func_prof_write_str(i32 %fd, ptr @__func_prof_tab)
+  call void @__func_prof_write_str(i32 %fd, ptr %name)
+  call void @__func_prof_write_str(i32 %fd, ptr @__func_prof_newline)
+  br label %next
+
+next:
+  %next_i = add i32 %i, 1
+  br label %cond
+
+close:
+  %is_file = icmp ne i32 %fd, 2
+  br i1 %is_file, label %do_close, label %done
+
+do_close:
+  %fd64 = sext i32 %fd to i64
+  ; SYS_CLOSE(fd)
+  %closed = call i64 asm sideeffect "syscall", "={rax},{rax},{rdi},~{rcx},~{r11},~{memory}"(i64 3, i64 %fd64)
+  br label %done
+
+done:
+  ret void
+}
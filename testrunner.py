@@ -150,7 +150,6 @@ def compile_test(root: Path, case: TestCase) -> tuple[CompiledTest | None, str |
         "./compile.sh",
         "-o",
         str(exe_path),
-        "stdlib/utils.fc",
         str(case.path),
     ]
 